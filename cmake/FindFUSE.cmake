@@ -0,0 +1,65 @@
+
+# Copyright (C) 2014 Daniel Scharrer
+#
+# This software is provided 'as-is', without any express or implied
+# warranty.  In no event will the author(s) be held liable for any damages
+# arising from the use of this software.
+#
+# Permission is granted to anyone to use this software for any purpose,
+# including commercial applications, and to alter it and redistribute it
+# freely, subject to the following restrictions:
+#
+# 1. The origin of this software must not be misrepresented; you must not
+#    claim that you wrote the original software. If you use this software
+#    in a product, an acknowledgment in the product documentation would be
+#    appreciated but is not required.
+# 2. Altered source versions must be plainly marked as such, and must not be
+#    misrepresented as being the original software.
+# 3. This notice may not be removed or altered from any source distribution.
+
+# Try to find the FUSE library and include path for fuse.h.
+# Once done this will define
+#
+# FUSE_FOUND
+# FUSE_INCLUDE_DIR   Where to find fuse.h
+# FUSE_LIBRARIES     The libfuse library
+# FUSE_DEFINITIONS   Definitions to use when compiling code that uses libfuse
+#
+# Typical usage could be something like:
+#   find_package(FUSE)
+#   include_directories(SYSTEM ${FUSE_INCLUDE_DIR})
+#   add_definitions(${FUSE_DEFINITIONS})
+#   ...
+#   target_link_libraries(myexe ${FUSE_LIBRARIES})
+
+if(UNIX)
+	find_package(PkgConfig QUIET)
+	pkg_check_modules(_PC_FUSE fuse)
+endif()
+
+find_path(FUSE_INCLUDE_DIR fuse.h
+	HINTS
+		${_PC_FUSE_INCLUDE_DIRS}
+	PATH_SUFFIXES fuse
+	DOC "The directory where fuse.h resides"
+)
+mark_as_advanced(FUSE_INCLUDE_DIR)
+
+find_library(FUSE_LIBRARY fuse
+	HINTS
+		${_PC_FUSE_LIBRARY_DIRS}
+	DOC "The FUSE library"
+)
+mark_as_advanced(FUSE_LIBRARY)
+
+# libfuse requires a 64-bit off_t
+set(FUSE_DEFINITIONS -D_FILE_OFFSET_BITS=64)
+
+# handle the QUIETLY and REQUIRED arguments and set FUSE_FOUND to TRUE if
+# all listed variables are TRUE
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(FUSE DEFAULT_MSG FUSE_LIBRARY FUSE_INCLUDE_DIR)
+
+if(FUSE_FOUND)
+	set(FUSE_LIBRARIES ${FUSE_LIBRARY})
+endif(FUSE_FOUND)
@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "cli/archive.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/foreach.hpp>
+
+namespace {
+
+//! Size of the write buffer - a multiple of the tar block size.
+const size_t buffer_size = 1024 * 1024;
+
+const size_t tar_block_size = 512;
+
+const boost::uint32_t cpio_directory_mode = 0040755;
+const boost::uint32_t cpio_file_mode = 0100644;
+
+//! Store a number as a zero-padded octal string terminated by a NUL character.
+bool store_octal(char * field, size_t length, boost::uint64_t value) {
+	for(size_t i = length - 1; i-- > 0; ) {
+		field[i] = char('0' + (value & 7));
+		value >>= 3;
+	}
+	field[length - 1] = '\0';
+	return value == 0;
+}
+
+size_t count_digits(size_t value) {
+	size_t digits = 1;
+	for(; value >= 10; value /= 10) {
+		digits++;
+	}
+	return digits;
+}
+
+//! Format a pax extended header record: "<length> <key>=<value>\n"
+std::string pax_record(const std::string & key, const std::string & value) {
+	
+	// The length includes the length field itself
+	size_t length = key.size() + value.size() + 3;
+	size_t total = length + count_digits(length);
+	if(count_digits(total) != count_digits(length)) {
+		total++;
+	}
+	
+	std::ostringstream oss;
+	oss << total << ' ' << key << '=' << value << '\n';
+	return oss.str();
+}
+
+} // anonymous namespace
+
+archive_writer::archive_writer(std::ostream & os, format type)
+	: os(os), type(type), buffer(buffer_size), buffered(0),
+	  position(0), remaining(0), next_inode(1) { }
+
+void archive_writer::append(const char * data, size_t size) {
+	
+	position += size;
+	
+	while(size > 0) {
+		size_t n = std::min(size, buffer.size() - buffered);
+		std::memcpy(&buffer[buffered], data, n);
+		buffered += n, data += n, size -= n;
+		if(buffered == buffer.size()) {
+			flush();
+		}
+	}
+}
+
+void archive_writer::flush() {
+	if(buffered) {
+		os.write(&buffer.front(), std::streamsize(buffered));
+		buffered = 0;
+		if(os.fail()) {
+			throw std::runtime_error("Error writing archive");
+		}
+	}
+}
+
+void archive_writer::pad() {
+	
+	static const char zeros[tar_block_size] = { 0 };
+	
+	size_t alignment = (type == Tar) ? tar_block_size : 4;
+	size_t padding = size_t(-position % alignment);
+	
+	append(zeros, padding);
+}
+
+void archive_writer::tar_header(const std::string & name, char typeflag, boost::uint64_t size,
+                                util::time mtime, const std::string & link) {
+	
+	char header[tar_block_size];
+	std::memset(header, 0, sizeof(header));
+	
+	if(mtime < 0) {
+		mtime = 0;
+	}
+	
+	// Use a pax extended header for values that don't fit into the ustar header
+	std::string extended;
+	std::string short_name = name;
+	if(name.size() > 100) {
+		size_t split = name.find_last_of('/', 155);
+		if(split == std::string::npos || name.size() - split - 1 > 100 || split == 0) {
+			extended += pax_record("path", name);
+			short_name = name.substr(0, 100);
+		} else {
+			std::memcpy(header + 345, name.data(), split);
+			short_name = name.substr(split + 1);
+		}
+	}
+	if(link.size() > 100) {
+		extended += pax_record("linkpath", link);
+	}
+	if(!store_octal(header + 124, 12, size)) {
+		std::ostringstream oss;
+		oss << size;
+		extended += pax_record("size", oss.str());
+		store_octal(header + 124, 12, 0);
+	}
+	if(!extended.empty()) {
+		tar_header("././@PaxHeader", 'x', extended.size(), mtime);
+		append(extended.data(), extended.size());
+		pad();
+	}
+	
+	std::memcpy(header, short_name.data(), std::min(short_name.size(), size_t(100)));
+	store_octal(header + 100, 8, (typeflag == '5') ? 0755 : 0644); // mode
+	store_octal(header + 108, 8, 0); // uid
+	store_octal(header + 116, 8, 0); // gid
+	store_octal(header + 136, 12, boost::uint64_t(mtime));
+	header[156] = typeflag;
+	std::memcpy(header + 157, link.data(), std::min(link.size(), size_t(100)));
+	std::memcpy(header + 257, "ustar", 6); // magic
+	std::memcpy(header + 263, "00", 2); // version
+	
+	// The checksum is calculated with the checksum field set to spaces
+	std::memset(header + 148, ' ', 8);
+	boost::uint32_t checksum = 0;
+	for(size_t i = 0; i < sizeof(header); i++) {
+		checksum += boost::uint8_t(header[i]);
+	}
+	store_octal(header + 148, 7, checksum);
+	
+	append(header, sizeof(header));
+}
+
+void archive_writer::cpio_header(const std::string & name, boost::uint32_t mode,
+                                 boost::uint32_t ino, boost::uint32_t nlink,
+                                 boost::uint64_t size, util::time mtime) {
+	
+	if(size > 0xffffffffu) {
+		throw std::runtime_error("File \"" + name + "\" is too large for the cpio format");
+	}
+	
+	if(mtime < 0) {
+		mtime = 0;
+	} else if(mtime > 0xffffffffl) {
+		mtime = 0xffffffffl;
+	}
+	
+	char header[6 + 13 * 8 + 1];
+	std::sprintf(header, "070701%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X",
+	             ino, mode, 0u, 0u, nlink, boost::uint32_t(mtime), boost::uint32_t(size),
+	             0u, 0u, 0u, 0u, boost::uint32_t(name.size() + 1), 0u);
+	
+	append(header, sizeof(header) - 1);
+	append(name.c_str(), name.size() + 1);
+	pad();
+}
+
+void archive_writer::add_directories(const std::string & path, util::time mtime) {
+	
+	size_t end = path.find('/');
+	while(end != std::string::npos) {
+		
+		std::string directory = path.substr(0, end);
+		if(directories.insert(directory).second) {
+			if(type == Tar) {
+				tar_header(directory + '/', '5', 0, mtime);
+			} else {
+				cpio_header(directory, cpio_directory_mode, next_inode++, 2, 0, mtime);
+			}
+		}
+		
+		end = path.find('/', end + 1);
+	}
+}
+
+void archive_writer::begin(const std::vector<std::string> & names, boost::uint64_t size,
+                           util::time mtime) {
+	
+	if(remaining) {
+		throw std::logic_error("archive entry data incomplete");
+	}
+	
+	BOOST_FOREACH(const std::string & name, names) {
+		add_directories(name, mtime);
+	}
+	
+	if(type == Tar) {
+		
+		tar_header(names.front(), '0', size, mtime);
+		
+	} else {
+		
+		// Hard links share the same inode and only the last entry contains the data
+		boost::uint32_t ino = next_inode++;
+		boost::uint32_t nlink = boost::uint32_t(names.size());
+		for(size_t i = 0; i + 1 < names.size(); i++) {
+			cpio_header(names[i], cpio_file_mode, ino, nlink, 0, mtime);
+		}
+		cpio_header(names.back(), cpio_file_mode, ino, nlink, size, mtime);
+		
+	}
+	
+	if(type == Tar) {
+		// Hard links must come after the file they link to - write them with the padding
+		links.assign(names.begin() + 1, names.end());
+		link_target = names.front();
+		link_time = mtime;
+	}
+	
+	remaining = size;
+	if(!remaining) {
+		end_entry();
+	}
+}
+
+void archive_writer::end_entry() {
+	
+	pad();
+	
+	BOOST_FOREACH(const std::string & link, links) {
+		tar_header(link, '1', 0, link_time, link_target);
+	}
+	links.clear();
+}
+
+void archive_writer::write(const char * data, size_t size) {
+	
+	if(size > remaining) {
+		throw std::logic_error("too much data for archive entry");
+	}
+	
+	append(data, size);
+	remaining -= size;
+	
+	if(size && remaining == 0) {
+		end_entry();
+	}
+}
+
+void archive_writer::finish() {
+	
+	if(remaining) {
+		throw std::logic_error("archive entry data incomplete");
+	}
+	
+	if(type == Tar) {
+		// Two zero blocks mark the end of the archive
+		static const char zeros[2 * tar_block_size] = { 0 };
+		append(zeros, sizeof(zeros));
+	} else {
+		cpio_header("TRAILER!!!", 0, 0, 1, 0, 0);
+	}
+	
+	flush();
+	os.flush();
+}
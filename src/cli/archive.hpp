@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Writer for tar and cpio archives used to stream extracted files.
+ */
+#ifndef INNOEXTRACT_CLI_ARCHIVE_HPP
+#define INNOEXTRACT_CLI_ARCHIVE_HPP
+
+#include <stddef.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "util/time.hpp"
+
+/*!
+ * Sequentially write files to a tar (POSIX pax/ustar) or cpio (SVR4 "newc") archive.
+ *
+ * Output is collected in a large buffer and written to the stream in big blocks.
+ * Parent directories are added automatically before the first file they contain.
+ */
+class archive_writer : private boost::noncopyable {
+	
+public:
+	
+	enum format {
+		Tar,
+		Cpio
+	};
+	
+	/*!
+	 * \param os     The stream to write the archive to. Must stay valid until
+	 *               \ref finish() has been called.
+	 * \param format The archive format to write.
+	 */
+	archive_writer(std::ostream & os, format type);
+	
+	/*!
+	 * Start a new file.
+	 *
+	 * Exactly \c size bytes of file data must be written using \ref write() before
+	 * starting the next file or finishing the archive.
+	 *
+	 * \param names Paths of the file, using '/' as the separator. Additional names
+	 *              are stored as hard links to the first one.
+	 * \param size  Size of the file data.
+	 * \param mtime Modification time of the file.
+	 *
+	 * \throws std::runtime_error if the file cannot be represented in the archive format.
+	 */
+	void begin(const std::vector<std::string> & names, boost::uint64_t size, util::time mtime);
+	
+	//! Write data for the current file.
+	void write(const char * data, size_t size);
+	
+	//! Write the archive trailer and flush all buffered data.
+	void finish();
+	
+private:
+	
+	void add_directories(const std::string & path, util::time mtime);
+	
+	void tar_header(const std::string & name, char type, boost::uint64_t size,
+	                util::time mtime, const std::string & link = std::string());
+	
+	void cpio_header(const std::string & name, boost::uint32_t mode, boost::uint32_t ino,
+	                 boost::uint32_t nlink, boost::uint64_t size, util::time mtime);
+	
+	void end_entry();
+	void pad();
+	void append(const char * data, size_t size);
+	void flush();
+	
+	std::ostream & os;
+	const format type;
+	
+	std::vector<char> buffer;
+	size_t buffered;
+	
+	boost::uint64_t position; //!< Number of bytes written for the archive so far.
+	boost::uint64_t remaining; //!< Data bytes remaining for the current file.
+	boost::uint32_t next_inode;
+	
+	boost::unordered_set<std::string> directories;
+	
+	std::vector<std::string> links; //!< Pending hard links for the current tar entry.
+	std::string link_target;
+	util::time link_time;
+	
+};
+
+#endif // INNOEXTRACT_CLI_ARCHIVE_HPP
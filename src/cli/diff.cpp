@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "cli/diff.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "cli/extract.hpp"
+#include "cli/verify.hpp"
+
+#include "loader/offsets.hpp"
+#include "loader/plan.hpp"
+
+#include "setup/data.hpp"
+#include "setup/file.hpp"
+#include "setup/filter.hpp"
+#include "setup/info.hpp"
+
+#include "util/fstream.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+//! Output paths of the selected files, mapped to the data entry that is extracted last.
+typedef boost::unordered_map<std::string, size_t> file_map;
+
+void load_files(const fs::path & file, const extract_options & o,
+                const setup::path_filter & includes, setup::info & info, file_map & files) {
+	
+	util::ifstream ifs(file, std::ios_base::in | std::ios_base::binary);
+	if(!ifs.is_open()) {
+		throw std::runtime_error("Could not open file \"" + file.string() + '"');
+	}
+	
+	loader::offsets offsets;
+	offsets.load(ifs);
+	
+	ifs.seekg(offsets.header_offset);
+	try {
+		info.load(ifs, setup::info::DataEntries | setup::info::Files);
+	} catch(const std::ios_base::failure & e) {
+		std::ostringstream oss;
+		oss << "Stream error while parsing setup headers of " << file << "!\n";
+		oss << " ├─ detected setup version was " << info.version << '\n';
+		oss << " └─ error reason was " << e.what();
+		throw format_error(oss.str());
+	}
+	
+	std::vector<std::string> paths;
+	std::vector<bool> selected;
+	select_files(info, o, includes, paths, selected);
+	
+	BOOST_FOREACH(setup::data_entry & location, info.data_entries) {
+		if(location.chunk.compression == stream::UnknownCompression) {
+			location.chunk.compression = info.header.compression;
+		}
+	}
+	
+	// Compare the data that extraction actually leaves at each path
+	loader::plan plan;
+	plan.build(info, selected);
+	std::vector<bool> final;
+	find_final_files(plan, paths, final);
+	
+	for(size_t i = 0; i < info.files.size(); i++) {
+		if(final[i]) {
+			files[paths[i]] = info.files[i].location;
+		}
+	}
+}
+
+//! \return a key that is equal for files with the same size and checksum.
+std::string content_key(const setup::data_entry & entry) {
+	std::ostringstream oss;
+	oss << entry.file.size << ' ' << entry.file.checksum;
+	return oss.str();
+}
+
+bool same_contents(const setup::data_entry & a, const setup::data_entry & b) {
+	return a.file.size == b.file.size && a.file.checksum == b.file.checksum;
+}
+
+} // anonymous namespace
+
+size_t diff_files(const fs::path & old_file, const fs::path & new_file,
+                  const extract_options & o) {
+	
+	setup::path_filter includes;
+	BOOST_FOREACH(const std::string & include, o.include) {
+		includes.add(include);
+	}
+	includes.compile();
+	
+	setup::info old_info, new_info;
+	file_map old_files, new_files;
+	load_files(old_file, o, includes, old_info, old_files);
+	load_files(new_file, o, includes, new_info, new_files);
+	
+	// Each record is the path to sort by and the line to print
+	typedef std::pair<std::string, std::string> record;
+	std::vector<record> records;
+	
+	std::vector<std::string> removed, added;
+	size_t changed = 0, unchanged = 0;
+	BOOST_FOREACH(const file_map::value_type & file, old_files) {
+		file_map::const_iterator other = new_files.find(file.first);
+		if(other == new_files.end()) {
+			removed.push_back(file.first);
+		} else if(!same_contents(old_info.data_entries[file.second],
+		                         new_info.data_entries[other->second])) {
+			records.push_back(record(file.first, "changed\t" + file.first));
+			changed++;
+		} else {
+			unchanged++;
+		}
+	}
+	BOOST_FOREACH(const file_map::value_type & file, new_files) {
+		if(old_files.find(file.first) == old_files.end()) {
+			added.push_back(file.first);
+		}
+	}
+	
+	std::sort(removed.begin(), removed.end());
+	std::sort(added.begin(), added.end());
+	
+	/*
+	 * Pair up removed and added files with the same contents.
+	 * Empty files all have the same contents, so they are never considered moved.
+	 */
+	typedef boost::unordered_map<std::string, std::vector<std::string> > content_map;
+	content_map removed_contents;
+	BOOST_FOREACH(const std::string & path, removed) {
+		const setup::data_entry & entry = old_info.data_entries[old_files[path]];
+		if(entry.file.size != 0) {
+			removed_contents[content_key(entry)].push_back(path);
+		}
+	}
+	
+	// Paths are consumed from the back, so reverse to pair them in sorted order
+	BOOST_FOREACH(content_map::value_type & paths, removed_contents) {
+		std::reverse(paths.second.begin(), paths.second.end());
+	}
+	
+	size_t moved = 0;
+	boost::unordered_set<std::string> was_moved;
+	BOOST_FOREACH(const std::string & path, added) {
+		const setup::data_entry & entry = new_info.data_entries[new_files[path]];
+		content_map::iterator i = removed_contents.end();
+		if(entry.file.size != 0) {
+			i = removed_contents.find(content_key(entry));
+		}
+		if(i != removed_contents.end() && !i->second.empty()) {
+			const std::string & source = i->second.back();
+			records.push_back(record(source, "moved\t" + source + '\t' + path));
+			was_moved.insert(source);
+			i->second.pop_back();
+			moved++;
+		} else {
+			records.push_back(record(path, "added\t" + path));
+		}
+	}
+	BOOST_FOREACH(const std::string & path, removed) {
+		if(was_moved.find(path) == was_moved.end()) {
+			records.push_back(record(path, "removed\t" + path));
+		}
+	}
+	
+	std::sort(records.begin(), records.end());
+	BOOST_FOREACH(const record & entry, records) {
+		std::cout << entry.second << '\n';
+	}
+	
+	if(!o.quiet) {
+		std::cout << (added.size() - moved) << " added, " << (removed.size() - moved)
+		          << " removed, " << changed << " changed, " << moved << " moved, "
+		          << unchanged << " unchanged\n";
+	}
+	
+	std::cout.flush();
+	
+	return records.size();
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Comparison of the files contained in two setup files.
+ */
+#ifndef INNOEXTRACT_CLI_DIFF_HPP
+#define INNOEXTRACT_CLI_DIFF_HPP
+
+#include <stddef.h>
+
+#include <boost/filesystem/path.hpp>
+
+struct extract_options;
+
+/*!
+ * Compare the files in two setup files using only the setup headers.
+ *
+ * Files are matched by their output path and compared by size and checksum.
+ * One tab-separated line is printed to stdout for each difference:
+ *
+ *   - <tt>added\\t\<path\></tt> for files only in the new setup file
+ *   - <tt>removed\\t\<path\></tt> for files only in the old setup file
+ *   - <tt>changed\\t\<path\></tt> for files with different contents
+ *   - <tt>moved\\t\<old path\>\\t\<new path\></tt> for removed files whose contents
+ *     reappear under a new path
+ *
+ * Lines are sorted by the (old) path.
+ *
+ * \param old_file Path to the old setup file.
+ * \param new_file Path to the new setup file.
+ * \param o        Options containing the language, include and filename settings.
+ *
+ * \return the number of differences.
+ */
+size_t diff_files(const boost::filesystem::path & old_file,
+                  const boost::filesystem::path & new_file, const extract_options & o);
+
+#endif // INNOEXTRACT_CLI_DIFF_HPP
@@ -21,9 +21,9 @@
 #include "cli/extract.hpp"
 
 #include <algorithm>
+#include <ctime>
 #include <iomanip>
 #include <iostream>
-#include <map>
 #include <sstream>
 #include <vector>
 
@@ -33,18 +33,25 @@
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/range/size.hpp>
 
+#include "cli/archive.hpp"
 #include "cli/debug.hpp"
 #include "cli/gog.hpp"
+#include "cli/journal.hpp"
+#include "cli/output.hpp"
+#include "cli/verify.hpp"
 
 #include "loader/offsets.hpp"
+#include "loader/plan.hpp"
 
 #include "setup/data.hpp"
 #include "setup/expression.hpp"
 #include "setup/file.hpp"
+#include "setup/filter.hpp"
 #include "setup/info.hpp"
 
 #include "stream/chunk.hpp"
 #include "stream/file.hpp"
+#include "stream/schedule.hpp"
 #include "stream/slice.hpp"
 
 #include "util/boostfs_compat.hpp"
@@ -57,25 +64,13 @@
 
 namespace fs = boost::filesystem;
 
-struct file_output {
-	
-	fs::path name;
-	util::ofstream stream;
-	
-	explicit file_output(const fs::path & file) : name(file) {
-		try {
-			fs::create_directories(name.parent_path());
-		} catch(...) {
-			throw std::runtime_error("Could not create directories for \""
-			                         + name.string() + '"');
-		}
-		stream.open(name, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
-		if(!stream.is_open()) {
-			throw std::runtime_error("Coul not open output file \"" + name.string() + '"');
-		}
+//! Convert an output path to the '/'-separated form used in archives.
+static std::string archive_path(std::string path) {
+	if(setup::path_sep != '/') {
+		std::replace(path.begin(), path.end(), setup::path_sep, '/');
 	}
-	
-};
+	return path;
+}
 
 static bool probe_bin_file(const fs::path & file) {
 	try {
@@ -98,6 +93,96 @@ static void probe_bin_files(const fs::path & dir, const std::string & basename,
 	}
 }
 
+//! Delete files in the output directory that are not part of the installer.
+static void delete_extra_files(const extract_options & o, const std::vector<std::string> & paths,
+                               const setup::path_filter & includes) {
+	
+	std::vector<std::string> extra;
+	find_extra_files(o.output_dir, paths, includes, extra);
+	
+	BOOST_FOREACH(const std::string & path, extra) {
+		
+		if(o.list) {
+			if(!o.silent) {
+				std::cout << " - \"" << color::dim_yellow << path << color::reset << "\" deleted\n";
+			} else {
+				std::cout << color::dim_yellow << path << color::reset << '\n';
+			}
+		}
+		
+		fs::path file = o.output_dir / path;
+		try {
+			fs::remove(file);
+		} catch(...) {
+			log_warning << "Could not delete " << file;
+			continue;
+		}
+		
+		// Remove directories that are now empty - walk up the relative path so that the
+		// output directory itself and anything above it is never touched
+		try {
+			fs::path parent = fs::path(path).parent_path();
+			while(!parent.empty() && fs::is_empty(o.output_dir / parent)) {
+				fs::remove(o.output_dir / parent);
+				parent = parent.parent_path();
+			}
+		} catch(...) {
+			// Not fatal - the directory is simply left in place
+		}
+	}
+}
+
+void select_files(const setup::info & info, const extract_options & o,
+                  const setup::path_filter & includes,
+                  std::vector<std::string> & paths, std::vector<bool> & selected) {
+	
+	setup::expression_matcher languages(o.language);
+	
+	paths.assign(info.files.size(), std::string());
+	selected.assign(info.files.size(), false);
+	for(size_t i = 0; i < info.files.size(); i++) {
+		
+		const setup::file_entry & entry = info.files[i];
+		if(entry.location >= info.data_entries.size() || entry.destination.empty()) {
+			continue;
+		}
+		
+		if(!o.language.empty() && !entry.languages.empty()) {
+			if(!languages.match(entry.languages)) {
+				continue;
+			}
+		}
+		
+		std::string path = o.filenames.convert(entry.destination);
+		if(!path.empty() && (includes.empty() || includes.match(path))) {
+			paths[i].swap(path);
+			selected[i] = true;
+		}
+	}
+}
+
+//! \return the kinds of setup header entries required for the requested actions.
+static setup::info::entry_types needed_entries(const extract_options & o) {
+	
+	setup::info::entry_types entries;
+	
+	if(o.list || o.test || o.extract || !o.verify_dir.empty()) {
+		entries |= setup::info::DataEntries | setup::info::Files;
+	}
+	
+	if(o.gog_game_id) {
+		entries |= setup::info::RegistryEntries;
+	}
+	
+#ifdef DEBUG
+	if(logger::debug) {
+		entries = setup::info::entry_types::all();
+	}
+#endif
+	
+	return entries;
+}
+
 void process_file(const fs::path & file, const extract_options & o) {
 	
 	bool is_directory;
@@ -126,20 +211,10 @@ void process_file(const fs::path & file, const extract_options & o) {
 	}
 #endif
 	
-	setup::info::entry_types entries = setup::info::DataEntries | setup::info::Files;
-	if(o.gog_game_id) {
-		entries |= setup::info::RegistryEntries;
-	}
-#ifdef DEBUG
-	if(logger::debug) {
-		entries = setup::info::entry_types::all();
-	}
-#endif
-	
 	ifs.seekg(offsets.header_offset);
 	setup::info info;
 	try {
-		info.load(ifs, entries);
+		info.load(ifs, needed_entries(o));
 	} catch(const std::ios_base::failure & e) {
 		std::ostringstream oss;
 		oss << "Stream error while parsing setup headers!\n";
@@ -152,7 +227,11 @@ void process_file(const fs::path & file, const extract_options & o) {
 		const std::string & name = info.header.app_versioned_name.empty()
 		                           ? info.header.app_name : info.header.app_versioned_name;
 		const char * verb = "Inspecting";
-		if(o.extract) {
+		if(!o.verify_dir.empty()) {
+			verb = "Verifying";
+		} else if(o.update) {
+			verb = "Updating";
+		} else if(o.extract) {
 			verb = "Extracting";
 		} else if(o.test) {
 			verb = "Testing";
@@ -188,41 +267,130 @@ void process_file(const fs::path & file, const extract_options & o) {
 		}
 	}
 	
-	if(!o.list && !o.test && !o.extract) {
+	if(!o.list && !o.test && !o.extract && o.verify_dir.empty()) {
 		return;
 	}
 	
-	boost::uint64_t total_size = 0;
-	
-	std::vector< std::vector<size_t> > files_for_location;
-	files_for_location.resize(info.data_entries.size());
-	for(size_t i = 0; i < info.files.size(); i++) {
-		if(info.files[i].location < files_for_location.size()) {
-			files_for_location[info.files[i].location].push_back(i);
-		}
+	setup::path_filter includes;
+	BOOST_FOREACH(const std::string & include, o.include) {
+		includes.add(include);
 	}
+	includes.compile();
 	
-	size_t max_slice = 0;
+	// Resolve filters and output names for all files before reading any data
+	std::vector<std::string> paths;
+	std::vector<bool> selected;
+	select_files(info, o, includes, paths, selected);
 	
-	typedef std::map<stream::file, size_t> Files;
-	typedef std::map<stream::chunk, Files> Chunks;
-	Chunks chunks;
-	for(size_t i = 0; i < info.data_entries.size(); i++) {
-		setup::data_entry & location = info.data_entries[i];
+	size_t max_slice = 0;
+	BOOST_FOREACH(setup::data_entry & location, info.data_entries) {
 		if(location.chunk.compression == stream::UnknownCompression) {
 			location.chunk.compression = info.header.compression;
 		}
-		chunks[location.chunk][location.file] = i;
-		total_size += location.file.size;
 		if(!offsets.data_offset) {
 			max_slice = std::max(max_slice, location.chunk.first_slice);
 			max_slice = std::max(max_slice, location.chunk.last_slice);
 		}
 	}
 	
+	// Only chunks containing wanted files are read
+	loader::plan plan;
+	plan.build(info, selected);
+	
+	if(!o.verify_dir.empty()) {
+		size_t problems = verify_tree(o.verify_dir, info, plan, paths, includes);
+		if(problems) {
+			log_error << "Found " << problems << (problems == 1 ? " problem" : " problems")
+			          << " in " << o.verify_dir;
+		} else if(!o.quiet) {
+			std::cout << "All files in " << o.verify_dir << " match\n";
+		}
+		return;
+	}
+	
+	// Find files that don't need to be written again
+	boost::scoped_ptr<extract_journal> journal;
+	std::vector<bool> file_done(info.files.size());
+	bool skip_done = o.extract && !o.archive && (o.resume || o.update);
+	if(skip_done) {
+		
+		// Files that are overwritten later never need to be written
+		std::vector<bool> final;
+		find_final_files(plan, paths, final);
+		
+		std::vector<size_t> check;
+		for(size_t i = 0; i < info.files.size(); i++) {
+			if(!selected[i]) {
+				continue;
+			} else if(!final[i]) {
+				file_done[i] = true;
+			} else {
+				check.push_back(i);
+			}
+		}
+		
+		if(o.resume) {
+			// Trust the journal of an earlier, interrupted run
+			journal.reset(new extract_journal(o.output_dir));
+			BOOST_FOREACH(size_t i, check) {
+				const setup::file_entry & entry = info.files[i];
+				const stream::file & data = info.data_entries[entry.location].file;
+				file_done[i] = journal->is_complete(entry.location, data, paths[i]);
+			}
+		} else {
+			// Compare the existing files against the installer
+			std::vector<file_state> results;
+			verify_files(o.output_dir, info, check, paths, results);
+			for(size_t i = 0; i < check.size(); i++) {
+				file_done[check[i]] = (results[i] == FileMatches);
+			}
+		}
+		
+	}
+	
+	std::vector<bool> entry_done(plan.entries().size());
+	std::vector<bool> chunk_done(plan.chunks().size());
+	if(skip_done) {
+		size_t done_count = 0;
+		for(size_t i = 0; i < plan.chunks().size(); i++) {
+			bool all_done = true;
+			for(size_t j = plan.entries_begin(i); j < plan.entries_end(i); j++) {
+				size_t data_index = plan.entries()[j];
+				bool done = true;
+				for(size_t k = plan.files_begin(data_index); k < plan.files_end(data_index); k++) {
+					done = done && file_done[plan.files()[k]];
+				}
+				entry_done[j] = done;
+				all_done = all_done && done;
+				done_count += done ? 1 : 0;
+			}
+			chunk_done[i] = all_done;
+		}
+		if(!o.quiet && done_count) {
+			std::cout << (o.resume ? "Resuming: " : "Updating: ") << color::white << done_count
+			          << color::reset << " of " << plan.entries().size()
+			          << (o.resume ? " files already extracted\n" : " files are up to date\n");
+		}
+	}
+	
+	boost::uint64_t total_size = 0;
+	for(size_t j = 0; j < plan.entries().size(); j++) {
+		if(!entry_done[j]) {
+			total_size += info.data_entries[plan.entries()[j]].file.size;
+		}
+	}
+	
 	fs::path dir = file.parent_path();
 	std::string basename = util::as_string(file.stem());
 	
+	stream::chunk_scheduler schedule;
+	for(size_t i = 0; i < plan.chunks().size(); i++) {
+		if(!plan.chunks()[i].encrypted && !chunk_done[i]) {
+			schedule.add(plan.chunks()[i]);
+		}
+	}
+	schedule.build();
+	
 	boost::scoped_ptr<stream::slice_reader> slice_reader;
 	if(o.extract || o.test) {
 		if(offsets.data_offset) {
@@ -232,81 +400,41 @@ void process_file(const fs::path & file, const extract_options & o) {
 		}
 	}
 	
-	progress extract_progress(total_size);
-
-	typedef std::pair<bool, std::string> Filter;
-	std::vector<Filter> includes;
-	BOOST_FOREACH(const std::string & include, o.include) {
-		if(!include.empty() && include[0] == setup::path_sep) {
-			includes.push_back(std::make_pair(true, include + setup::path_sep));
-		} else {
-			includes.push_back(std::make_pair(false, setup::path_sep + include + setup::path_sep));
-		}
+	boost::scoped_ptr<output_dir> outputs;
+	if(o.extract && !o.archive) {
+		outputs.reset(new output_dir(o.output_dir));
 	}
 	
-	BOOST_FOREACH(const Chunks::value_type & chunk, chunks) {
+	progress extract_progress(total_size);
+	
+	size_t chunk_index = 0;
+	for(size_t i = 0; i < plan.chunks().size(); i++) {
+		
+		const stream::chunk & chunk = plan.chunks()[i];
 		
-		debug("[starting " << chunk.first.compression << " chunk @ slice " << chunk.first.first_slice
-		      << " + " << print_hex(offsets.data_offset) << " + " << print_hex(chunk.first.offset)
+		debug("[starting " << chunk.compression << " chunk @ slice " << chunk.first_slice
+		      << " + " << print_hex(offsets.data_offset) << " + " << print_hex(chunk.offset)
 		      << ']');
 		
-		if(chunk.first.encrypted) {
+		if(chunk.encrypted) {
 			log_warning << "Skipping encrypted chunk (unsupported)";
 		}
 		
 		stream::chunk_reader::pointer chunk_source;
-		if((o.extract || o.test) && !chunk.first.encrypted) {
-			chunk_source = stream::chunk_reader::get(*slice_reader, chunk.first);
+		if((o.extract || o.test) && !chunk.encrypted && !chunk_done[i]) {
+			schedule.prepare(*slice_reader, chunk_index++);
+			chunk_source = stream::chunk_reader::get(*slice_reader, chunk);
 		}
 		boost::uint64_t offset = 0;
 		
-		BOOST_FOREACH(const Files::value_type & location, chunk.second) {
-			const stream::file & file = location.first;
+		for(size_t j = plan.entries_begin(i); j < plan.entries_end(i); j++) {
 			
-			// Convert output filenames
-			typedef std::pair<std::string, size_t> file_t;
-			std::vector<file_t> output_names;
-			for(size_t i = 0; i < files_for_location[location.second].size(); i++) {
-				
-				size_t file_i = files_for_location[location.second][i];
-				
-				if(!o.language.empty() && !info.files[file_i].languages.empty()) {
-					if(!setup::expression_match(o.language, info.files[file_i].languages)) {
-						continue;
-					}
-				}
-				
-				if(!info.files[file_i].destination.empty()) {
-					std::string path = o.filenames.convert(info.files[file_i].destination);
-					if(!path.empty()) {
-						bool filtered = false;
-						bool tokeep = false;
-						BOOST_FOREACH(const Filter & i, includes) {
-							filtered = true;
-							if(i.first) {
-								if(!i.second.compare(1, i.second.size() - 1,
-								                     path + setup::path_sep, 0, i.second.size() - 1)) {
-									tokeep = true;
-									break;
-								}
-							} else {
-								if((setup::path_sep + path + setup::path_sep).find(i.second) != std::string::npos) {
-									tokeep = true;
-									break;
-								}
-							}
-						}
-						if(!filtered || tokeep) {
-							output_names.push_back(std::make_pair(path, file_i));
-						}
-					}
-				}
-			}
+			size_t data_index = plan.entries()[j];
+			const setup::data_entry & data = info.data_entries[data_index];
+			const stream::file & file = data.file;
 			
-			if(output_names.empty()) {
-				extract_progress.update(location.first.size);
-				continue;
-			}
+			size_t names_begin = plan.files_begin(data_index);
+			size_t names_end = plan.files_end(data_index);
 			
 			// Print filename and size
 			if(o.list) {
@@ -317,17 +445,19 @@ void process_file(const fs::path & file, const extract_options & o) {
 					
 					std::cout << " - ";
 					bool named = false;
-					BOOST_FOREACH(const file_t & path, output_names) {
+					for(size_t k = names_begin; k < names_end; k++) {
+						const setup::file_entry & entry = info.files[plan.files()[k]];
+						const std::string & path = paths[plan.files()[k]];
 						if(named) {
 							std::cout << ", ";
 						}
-						if(chunk.first.encrypted) {
-							std::cout << '"' << color::dim_yellow << path.first << color::reset << '"' << " skipped";
+						if(chunk.encrypted) {
+							std::cout << '"' << color::dim_yellow << path << color::reset << '"' << " skipped";
 						} else {
-							std::cout << '"' << color::white << path.first << color::reset << '"';
+							std::cout << '"' << color::white << path << color::reset << '"';
 						}
-						if(!info.files[path.second].languages.empty()) {
-							std::cout << " [" << color::green << info.files[path.second].languages
+						if(!entry.languages.empty()) {
+							std::cout << " [" << color::green << entry.languages
 							          << color::reset << "]";
 						}
 						named = true;
@@ -345,8 +475,8 @@ void process_file(const fs::path & file, const extract_options & o) {
 					std::cout << '\n';
 					
 				} else {
-					BOOST_FOREACH(const file_t & path, output_names) {
-						std::cout << color::white << path.first << color::reset << '\n';
+					for(size_t k = names_begin; k < names_end; k++) {
+						std::cout << color::white << paths[plan.files()[k]] << color::reset << '\n';
 					}
 				}
 				
@@ -357,7 +487,7 @@ void process_file(const fs::path & file, const extract_options & o) {
 				
 			}
 			
-			if((!o.extract && !o.test) || chunk.first.encrypted) {
+			if((!o.extract && !o.test) || chunk.encrypted || entry_done[j]) {
 				continue;
 			}
 			
@@ -380,13 +510,29 @@ void process_file(const fs::path & file, const extract_options & o) {
 			stream::file_reader::pointer file_source;
 			file_source = stream::file_reader::get(*chunk_source, file, &checksum);
 			
+			util::time filetime = data.timestamp;
+			if(o.local_timestamps && !(data.options & data.TimeStampInUTC)) {
+				filetime = util::to_local_time(filetime);
+			}
+			
 			// Open output files
-			boost::ptr_vector<file_output> output;
-			if(!o.test) {
-				output.reserve(output_names.size());
-				BOOST_FOREACH(const file_t & path, output_names) {
+			boost::ptr_vector<output_file> output;
+			if(!o.test && o.archive) {
+				std::vector<std::string> names;
+				names.reserve(names_end - names_begin);
+				for(size_t k = names_begin; k < names_end; k++) {
+					names.push_back(archive_path(paths[plan.files()[k]]));
+				}
+				util::time mtime = o.preserve_file_times ? filetime : util::time(std::time(NULL));
+				o.archive->begin(names, file.size, mtime);
+			} else if(!o.test) {
+				output.reserve(names_end - names_begin);
+				for(size_t k = names_begin; k < names_end; k++) {
+					if(file_done[plan.files()[k]]) {
+						continue;
+					}
 					try {
-						output.push_back(new file_output(o.output_dir / path.first));
+						output.push_back(new output_file(*outputs, paths[plan.files()[k]]));
 					} catch(boost::bad_pointer &) {
 						// should never happen
 						std::terminate();
@@ -395,37 +541,44 @@ void process_file(const fs::path & file, const extract_options & o) {
 			}
 			
 			// Copy data
+			boost::uint64_t written = 0;
 			while(!file_source->eof()) {
 				char buffer[8192 * 10];
 				std::streamsize buffer_size = std::streamsize(boost::size(buffer));
 				std::streamsize n = file_source->read(buffer, buffer_size).gcount();
 				if(n > 0) {
-					BOOST_FOREACH(file_output & out, output) {
-						out.stream.write(buffer, n);
-						if(out.stream.fail()) {
+					if(!o.test && o.archive) {
+						if(written + boost::uint64_t(n) > file.size) {
+							throw format_error("File data is larger than the stored size!");
+						}
+						o.archive->write(buffer, size_t(n));
+					}
+					BOOST_FOREACH(output_file & out, output) {
+						if(!out.write(buffer, size_t(n))) {
 							throw std::runtime_error("Error writing file \""
-							                         + out.name.string() + '"');
+							                         + out.path().string() + '"');
 						}
 					}
+					written += boost::uint64_t(n);
 					extract_progress.update(boost::uint64_t(n));
 				}
 			}
+			if(!o.test && o.archive && written != file.size) {
+				throw format_error("File data is smaller than the stored size!");
+			}
 			
 			// Adjust file timestamps
 			if(o.preserve_file_times) {
-				const setup::data_entry & data = info.data_entries[location.second];
-				util::time filetime = data.timestamp;
-				if(o.local_timestamps && !(data.options & data.TimeStampInUTC)) {
-					filetime = util::to_local_time(filetime);
-				}
-				BOOST_FOREACH(file_output & out, output) {
-					out.stream.close();
-					if(!util::set_file_time(out.name, filetime, data.timestamp_nsec)) {
-						log_warning << "Error setting timestamp on file " << out.name;
+				BOOST_FOREACH(output_file & out, output) {
+					if(!out.close(filetime, data.timestamp_nsec)) {
+						log_warning << "Error setting timestamp on file " << out.path();
 					}
 				}
 			}
 			
+			// Close output files so that they are complete before being journaled
+			output.clear();
+			
 			// Verify checksums
 			if(checksum != file.checksum) {
 				log_warning << "Checksum mismatch:\n"
@@ -434,12 +587,25 @@ void process_file(const fs::path & file, const extract_options & o) {
 				if(o.test) {
 					throw std::runtime_error("Integrity test failed!");
 				}
+			} else if(journal) {
+				std::vector<std::string> names;
+				names.reserve(names_end - names_begin);
+				for(size_t k = names_begin; k < names_end; k++) {
+					if(!file_done[plan.files()[k]]) {
+						names.push_back(paths[plan.files()[k]]);
+					}
+				}
+				journal->add(data_index, file, checksum, names);
 			}
 		}
 	}
 	
 	extract_progress.clear();
 	
+	if(o.update && o.delete_extra && o.extract && !o.archive) {
+		delete_extra_files(o, paths, includes);
+	}
+	
 	if(o.warn_unused) {
 		probe_bin_file(dir / (basename + ".bin"));
 		probe_bin_file(dir / (basename + "-0" + ".bin"));
@@ -34,6 +34,9 @@
 
 #include "setup/filename.hpp"
 
+class archive_writer;
+namespace setup { struct info; class path_filter; }
+
 struct format_error : public std::runtime_error {
 	explicit format_error(const std::string & reason) : std::runtime_error(reason) { }
 };
@@ -50,6 +53,12 @@ struct extract_options {
 	bool extract; // The --extract action has been specified or automatically enabled
 	bool gog_game_id; // The --gog-game-id action has been explicitely specified
 	
+	boost::filesystem::path verify_dir; //!< Compare this directory against the installer
+	
+	bool resume; //!< Skip files recorded as complete in the output directory's journal
+	bool update; //!< Skip files in the output directory that already match the installer
+	bool delete_extra; //!< Delete files in the output directory that are not in the installer
+	
 	bool preserve_file_times;
 	bool local_timestamps;
 	
@@ -60,8 +69,24 @@ struct extract_options {
 	
 	boost::filesystem::path output_dir;
 	
+	archive_writer * archive; //!< Write files to this archive instead of output_dir
+	
 };
 
+/*!
+ * Determine which files are selected by the language and include filters and where
+ * they will be written.
+ *
+ * \param info     Setup headers including the file and data entries.
+ * \param o        Options containing the language and filename settings.
+ * \param includes Compiled \ref extract_options::include patterns.
+ * \param paths    Receives the output path for each file entry.
+ * \param selected Receives whether each file entry should be processed.
+ */
+void select_files(const setup::info & info, const extract_options & o,
+                  const setup::path_filter & includes,
+                  std::vector<std::string> & paths, std::vector<bool> & selected);
+
 void process_file(const boost::filesystem::path & file, const extract_options & o);
 
 #endif // INNOEXTRACT_CLI_EXTRACT_HPP
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "cli/journal.hpp"
+
+#include <stdexcept>
+#include <sstream>
+
+#include <boost/foreach.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/range/size.hpp>
+
+#include "crypto/checksum.hpp"
+#include "stream/file.hpp"
+#include "util/log.hpp"
+
+namespace fs = boost::filesystem;
+
+const char * const extract_journal::filename = ".innoextract-journal";
+
+namespace {
+
+const char journal_magic[] = "innoextract journal 1";
+
+void print_hex(std::string & out, const char * data, size_t size) {
+	static const char digits[] = "0123456789abcdef";
+	for(size_t i = 0; i < size; i++) {
+		boost::uint8_t byte = boost::uint8_t(data[i]);
+		out.push_back(digits[byte >> 4]);
+		out.push_back(digits[byte & 0xf]);
+	}
+}
+
+std::string checksum_string(const crypto::checksum & checksum) {
+	
+	std::string result;
+	
+	switch(checksum.type) {
+		case crypto::Adler32: {
+			result = "adler32:";
+			char value[4];
+			for(size_t i = 0; i < 4; i++) {
+				value[i] = char(checksum.adler32 >> (24 - 8 * i));
+			}
+			print_hex(result, value, sizeof(value));
+			break;
+		}
+		case crypto::CRC32: {
+			result = "crc32:";
+			char value[4];
+			for(size_t i = 0; i < 4; i++) {
+				value[i] = char(checksum.crc32 >> (24 - 8 * i));
+			}
+			print_hex(result, value, sizeof(value));
+			break;
+		}
+		case crypto::MD5: {
+			result = "md5:";
+			print_hex(result, checksum.md5, size_t(boost::size(checksum.md5)));
+			break;
+		}
+		case crypto::SHA1: {
+			result = "sha1:";
+			print_hex(result, checksum.sha1, size_t(boost::size(checksum.sha1)));
+			break;
+		}
+	}
+	
+	return result;
+}
+
+//! Split off the next tab-separated field starting at pos.
+bool next_field(const std::string & line, size_t & pos, std::string & field) {
+	size_t end = line.find('\t', pos);
+	if(end == std::string::npos) {
+		return false;
+	}
+	field.assign(line, pos, end - pos);
+	pos = end + 1;
+	return true;
+}
+
+} // anonymous namespace
+
+extract_journal::extract_journal(const fs::path & dir) : dir(dir) {
+	
+	fs::path file = dir / filename;
+	
+	bool exists;
+	try {
+		exists = fs::exists(file);
+	} catch(...) {
+		exists = false;
+	}
+	
+	if(exists) {
+		boost::uint64_t valid_size = load(file);
+		try {
+			if(fs::file_size(file) != valid_size) {
+				// Drop a line that was cut short when the last run was interrupted
+				fs::resize_file(file, valid_size);
+			}
+		} catch(...) {
+			throw std::runtime_error("Could not repair journal file \"" + file.string() + '"');
+		}
+	}
+	
+	stream.open(file, std::ios_base::out | std::ios_base::binary | std::ios_base::app);
+	if(!stream.is_open()) {
+		throw std::runtime_error("Could not open journal file \"" + file.string() + '"');
+	}
+	
+	if(!exists) {
+		stream << journal_magic << '\n';
+		stream.flush();
+	}
+	
+}
+
+boost::uint64_t extract_journal::load(const fs::path & file) {
+	
+	util::ifstream ifs(file, std::ios_base::in | std::ios_base::binary);
+	if(!ifs.is_open()) {
+		throw std::runtime_error("Could not read journal file \"" + file.string() + '"');
+	}
+	
+	std::string line;
+	if(!std::getline(ifs, line) || ifs.eof() || line != journal_magic) {
+		throw std::runtime_error("Unsupported journal file \"" + file.string() + '"');
+	}
+	
+	boost::uint64_t valid_size = line.size() + 1;
+	size_t ignored = 0;
+	while(std::getline(ifs, line)) {
+		
+		if(ifs.eof()) {
+			// The last line is incomplete
+			break;
+		}
+		valid_size += line.size() + 1;
+		if(line.empty()) {
+			continue;
+		}
+		
+		size_t pos = 0;
+		std::string index, size;
+		record entry;
+		if(!next_field(line, pos, index) || !next_field(line, pos, size)
+		   || !next_field(line, pos, entry.checksum) || pos == line.size()) {
+			ignored++;
+			continue;
+		}
+		
+		std::istringstream iss(index + ' ' + size);
+		if(!(iss >> entry.data_index >> entry.size)) {
+			ignored++;
+			continue;
+		}
+		
+		completed[line.substr(pos)] = entry;
+	}
+	
+	if(ignored) {
+		log_warning << "Ignored " << ignored << " invalid journal "
+		            << (ignored == 1 ? "entry" : "entries") << " in " << file;
+	}
+	
+	return valid_size;
+}
+
+bool extract_journal::is_complete(size_t data_index, const stream::file & file,
+                                  const std::string & path) const {
+	
+	record_map::const_iterator i = completed.find(path);
+	if(i == completed.end()) {
+		return false;
+	}
+	
+	const record & entry = i->second;
+	if(entry.data_index != data_index || entry.size != file.size
+	   || entry.checksum != checksum_string(file.checksum)) {
+		return false;
+	}
+	
+	try {
+		fs::path output = dir / path;
+		return fs::is_regular_file(output) && fs::file_size(output) == file.size;
+	} catch(...) {
+		return false;
+	}
+}
+
+void extract_journal::add(size_t data_index, const stream::file & file,
+                          const crypto::checksum & checksum,
+                          const std::vector<std::string> & paths) {
+	
+	record entry;
+	entry.data_index = data_index;
+	entry.size = file.size;
+	entry.checksum = checksum_string(checksum);
+	
+	BOOST_FOREACH(const std::string & path, paths) {
+		stream << entry.data_index << '\t' << entry.size << '\t' << entry.checksum
+		       << '\t' << path << '\n';
+		completed[path] = entry;
+	}
+	
+	if(!stream.flush()) {
+		throw std::runtime_error("Error writing journal file \"" + (dir / filename).string() + '"');
+	}
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Record of files that have been completely extracted, used to resume extraction.
+ */
+#ifndef INNOEXTRACT_CLI_JOURNAL_HPP
+#define INNOEXTRACT_CLI_JOURNAL_HPP
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "util/fstream.hpp"
+
+namespace crypto { struct checksum; }
+namespace stream { struct file; }
+
+/*!
+ * Append-only journal of completed files in an output directory.
+ *
+ * Each line records one output file of a data entry after all of its data has been
+ * written and the checksum has been verified:
+ *
+ *   <data entry index> TAB <size> TAB <checksum> TAB <path>
+ *
+ * Lines are only ever appended and flushed one data entry at a time, so a journal
+ * interrupted at any point remains valid - an incomplete last line is discarded.
+ * If the same path is recorded more than once, the last record wins.
+ */
+class extract_journal : private boost::noncopyable {
+	
+	struct record {
+		
+		size_t data_index;
+		boost::uint64_t size;
+		std::string checksum;
+		
+	};
+	
+	typedef boost::unordered_map<std::string, record> record_map;
+	
+	boost::filesystem::path dir;
+	
+	record_map completed;
+	
+	util::ofstream stream;
+	
+	//! \return the size of the journal up to the end of the last complete line.
+	boost::uint64_t load(const boost::filesystem::path & file);
+	
+public:
+	
+	//! Name of the journal file in the output directory.
+	static const char * const filename;
+	
+	/*!
+	 * Read any existing journal in the output directory and open it for appending.
+	 *
+	 * \throws std::runtime_error if the journal could not be read or opened.
+	 */
+	explicit extract_journal(const boost::filesystem::path & dir);
+	
+	/*!
+	 * \return \c true if the given file was completely extracted from the data entry
+	 *         and still exists with the expected size.
+	 */
+	bool is_complete(size_t data_index, const stream::file & file,
+	                 const std::string & path) const;
+	
+	//! \return the number of distinct paths recorded in the journal.
+	size_t size() const { return completed.size(); }
+	
+	/*!
+	 * Record that all output files for a data entry have been written and verified.
+	 *
+	 * \throws std::runtime_error if the journal could not be written.
+	 */
+	void add(size_t data_index, const stream::file & file, const crypto::checksum & checksum,
+	         const std::vector<std::string> & paths);
+	
+};
+
+#endif // INNOEXTRACT_CLI_JOURNAL_HPP
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem/path.hpp>
@@ -33,15 +34,24 @@
 
 #include "release.hpp"
 
+#include "cli/archive.hpp"
+#include "cli/diff.hpp"
 #include "cli/extract.hpp"
+#include "cli/probe.hpp"
 
 #include "setup/version.hpp"
 
 #include "util/console.hpp"
+#include "util/fstream.hpp"
 #include "util/log.hpp"
 #include "util/time.hpp"
 #include "util/windows.hpp"
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
 namespace fs = boost::filesystem;
 namespace po = boost::program_options;
 
@@ -118,6 +128,27 @@ static void print_license() {
 	;
 }
 
+//! Load one pattern per line, ignoring empty lines.
+static bool load_patterns(const std::string & file, std::vector<std::string> & patterns) {
+	
+	util::ifstream ifs(file, std::ios_base::in);
+	if(!ifs.is_open()) {
+		return false;
+	}
+	
+	std::string line;
+	while(std::getline(ifs, line)) {
+		if(!line.empty() && line[line.size() - 1] == '\r') {
+			line.resize(line.size() - 1);
+		}
+		if(!line.empty()) {
+			patterns.push_back(line);
+		}
+	}
+	
+	return !ifs.bad();
+}
+
 int main(int argc, char * argv[]) {
 	
 	po::options_description generic("Generic options");
@@ -133,6 +164,9 @@ int main(int argc, char * argv[]) {
 		("extract,e", "Extract files (default action)")
 		("list,l", "Only list files, don't write anything")
 		("gog-game-id", "Determine the GOG.com game ID for this installer")
+		("verify-tree", po::value<std::string>(), "Check previously extracted files in a directory")
+		("probe", "Only identify setup files and their versions")
+		("diff", "Compare the files in two setup files")
 	;
 	
 	po::options_description modifiers("Modifiers");
@@ -141,12 +175,19 @@ int main(int argc, char * argv[]) {
 		("lowercase,L", "Convert extracted filenames to lower-case")
 		("timestamps,T", po::value<std::string>(), "Timezone for file times or \"local\" or \"none\"")
 		("output-dir,d", po::value<std::string>(), "Extract files into the given directory")
+		("output-format", po::value<std::string>(), "Write \"files\" or a \"tar\" or \"cpio\" archive")
+		("output-file", po::value<std::string>(), "Archive file to write or \"-\" for stdout")
+		("resume", "Skip files already extracted to the output directory by an earlier run")
+		("update-tree", po::value<std::string>(), "Only write files in DIR that have changed")
+		("delete-extra", "Delete files from the --update-tree DIR that are not in the setup")
 	;
 	
 	po::options_description filter("Filters");
 	filter.add_options()
 		("language", po::value<std::string>(), "Extract only files for the given language")
 		("include,I", po::value< std::vector<std::string> >(), "Extract only files that match this path")
+		("include-from", po::value< std::vector<std::string> >(),
+		 "Extract only files that match a path listed in this file")
 	;
 	
 	po::options_description io("Display options");
@@ -156,6 +197,7 @@ int main(int argc, char * argv[]) {
 		("no-warn-unused", "Don't warn on unused .bin files")
 		("color,c", po::value<bool>()->implicit_value(true), "Enable/disable color output")
 		("progress,p", po::value<bool>()->implicit_value(true), "Enable/disable the progress bar")
+		("log-format", po::value<std::string>(), "Format for log messages: text or json")
 		#ifdef DEBUG
 			("debug,g", "Output debug information")
 		#endif
@@ -203,6 +245,22 @@ int main(int argc, char * argv[]) {
 	
 	o.warn_unused = (options.count("no-warn-unused") == 0);
 	
+	// Log format
+	bool json_log = false;
+	{
+		po::variables_map::const_iterator i = options.find("log-format");
+		if(i != options.end()) {
+			std::string format = i->second.as<std::string>();
+			if(boost::iequals(format, "json")) {
+				json_log = true;
+			} else if(!boost::iequals(format, "text")) {
+				color::init(color::disable, color::disable);
+				log_error << "Unsupported log format: " << format;
+				return ExitUserError;
+			}
+		}
+	}
+	
 	// Color / progress bar settings.
 	color::is_enabled color_e;
 	po::variables_map::const_iterator color_i = options.find("color");
@@ -218,6 +276,11 @@ int main(int argc, char * argv[]) {
 	} else {
 		progress_e = progress_i->second.as<bool>() ? color::enable : color::disable;
 	}
+	if(json_log) {
+		// Don't mix the progress bar with machine-readable output
+		progress_e = color::disable;
+		logger::set_format(logger::JSON);
+	}
 	color::init(color_e, progress_e);
 	
 	// Help output.
@@ -237,7 +300,14 @@ int main(int argc, char * argv[]) {
 	o.extract = (options.count("extract") != 0);
 	o.test = (options.count("test") != 0);
 	o.gog_game_id = (options.count("gog-game-id") != 0);
-	bool explicit_action = o.list || o.test || o.extract || o.gog_game_id;
+	{
+		po::variables_map::const_iterator i = options.find("verify-tree");
+		if(i != options.end()) {
+			o.verify_dir = i->second.as<std::string>();
+		}
+	}
+	bool verify = !o.verify_dir.empty();
+	bool explicit_action = o.list || o.test || o.extract || o.gog_game_id || verify;
 	if(!explicit_action) {
 		o.extract = true;
 	}
@@ -245,10 +315,14 @@ int main(int argc, char * argv[]) {
 		log_error << "Combining --extract and --test is not allowed!";
 		return ExitUserError;
 	}
+	if(verify && (o.list || o.test || o.extract)) {
+		log_error << "Combining --verify-tree with --list, --test or --extract is not allowed!";
+		return ExitUserError;
+	}
 	if(!o.extract && !o.test) {
 		progress::set_enabled(false);
 	}
-	if(!o.silent && !o.gog_game_id) {
+	if(!o.silent && !o.gog_game_id && !verify) {
 		o.list = true;
 	}
 	
@@ -295,6 +369,18 @@ int main(int argc, char * argv[]) {
 		}
 	}
 	
+	{
+		po::variables_map::const_iterator i = options.find("include-from");
+		if(i != options.end()) {
+			BOOST_FOREACH(const std::string & file, i->second.as<std::vector <std::string> >()) {
+				if(!load_patterns(file, o.include)) {
+					log_error << "Could not read include patterns from \"" << file << '"';
+					return ExitUserError;
+				}
+			}
+		}
+	}
+	
 	if(options.count("setup-files") == 0) {
 		if(!o.silent) {
 			std::cout << get_command(argv[0]) << ": no input files specified\n";
@@ -303,8 +389,40 @@ int main(int argc, char * argv[]) {
 		return ExitSuccess;
 	}
 	
+	const std::vector<std::string> & files = options["setup-files"]
+	                                         .as< std::vector<std::string> >();
+	
+	bool diff = (options.count("diff") != 0);
+	
+	if(options.count("probe")) {
+		if(explicit_action || diff) {
+			log_error << "Combining --probe with other actions is not allowed!";
+			return ExitUserError;
+		}
+		return probe_files(files) == 0 ? ExitSuccess : ExitDataError;
+	}
+	
+	if(diff) {
+		if(explicit_action) {
+			log_error << "Combining --diff with other actions is not allowed!";
+			return ExitUserError;
+		}
+		if(files.size() != 2) {
+			log_error << "--diff requires exactly two setup files";
+			return ExitUserError;
+		}
+	}
+	
+	if(options.count("update-tree") && options.count("output-dir")) {
+		log_error << "Combining --update-tree and --output-dir is not allowed!";
+		return ExitUserError;
+	}
+	
 	{
 		po::variables_map::const_iterator i = options.find("output-dir");
+		if(i == options.end()) {
+			i = options.find("update-tree");
+		}
 		if(i != options.end()) {
 			/*
 			 * We can't use fs::path directly with boost::program_options as fs::path's
@@ -325,13 +443,85 @@ int main(int argc, char * argv[]) {
 		}
 	}
 	
-	const std::vector<std::string> & files = options["setup-files"]
-	                                         .as< std::vector<std::string> >();
+	// Archive output
+	o.archive = NULL;
+	boost::scoped_ptr<archive_writer> archive;
+	boost::scoped_ptr<std::ostream> archive_stream;
+	std::streambuf * stdout_buffer = NULL;
+	{
+		po::variables_map::const_iterator i = options.find("output-format");
+		std::string format = (i != options.end()) ? i->second.as<std::string>() : "files";
+		archive_writer::format type;
+		if(boost::iequals(format, "tar")) {
+			type = archive_writer::Tar;
+		} else if(boost::iequals(format, "cpio")) {
+			type = archive_writer::Cpio;
+		} else if(!boost::iequals(format, "files")) {
+			log_error << "Unsupported output format: " << format;
+			return ExitUserError;
+		} else {
+			if(options.count("output-file")) {
+				log_error << "--output-file requires --output-format tar or cpio";
+				return ExitUserError;
+			}
+			format.clear();
+		}
+		if(!format.empty() && o.extract) {
+			i = options.find("output-file");
+			std::string file = (i != options.end()) ? i->second.as<std::string>() : "-";
+			if(file == "-") {
+				// Keep stdout for the archive data and send everything else to stderr
+				#ifdef _WIN32
+				_setmode(_fileno(stdout), _O_BINARY);
+				#endif
+				stdout_buffer = std::cout.rdbuf(std::cerr.rdbuf());
+				archive_stream.reset(new std::ostream(stdout_buffer));
+			} else {
+				fs::path path = o.output_dir / file;
+				util::ofstream * ofs = new util::ofstream;
+				archive_stream.reset(ofs);
+				ofs->open(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+				if(!ofs->is_open()) {
+					log_error << "Could not open output file " << path;
+					return ExitDataError;
+				}
+			}
+			archive.reset(new archive_writer(*archive_stream, type));
+			o.archive = archive.get();
+		}
+	}
+	
+	o.resume = (options.count("resume") != 0);
+	if(o.resume && (!o.extract || o.archive)) {
+		log_error << "--resume can only be used when extracting files to a directory";
+		return ExitUserError;
+	}
+	o.update = (options.count("update-tree") != 0);
+	if(o.update && (!o.extract || o.archive)) {
+		log_error << "--update-tree can only be used when extracting files to a directory";
+		return ExitUserError;
+	}
+	if(o.update && o.resume) {
+		log_error << "Combining --update-tree and --resume is not allowed!";
+		return ExitUserError;
+	}
+	o.delete_extra = (options.count("delete-extra") != 0);
+	if(o.delete_extra && !o.update) {
+		log_error << "--delete-extra requires --update-tree";
+		return ExitUserError;
+	}
 	
 	bool suggest_bug_report = false;
 	try {
-		BOOST_FOREACH(const std::string & file, files) {
-			process_file(file, o);
+		if(diff) {
+			diff_files(files[0], files[1], o);
+		} else {
+			BOOST_FOREACH(const std::string & file, files) {
+				process_file(file, o);
+			}
+		}
+		if(archive) {
+			archive->finish();
 		}
 	} catch(const std::ios_base::failure & e) {
 		log_error << "Stream error while extracting files!\n"
@@ -346,7 +536,9 @@ int main(int argc, char * argv[]) {
 		log_error << "Not a supported Inno Setup installer!";
 	}
 	
-	if(suggest_bug_report) {
+	logger::flush();
+	
+	if(suggest_bug_report && !json_log) {
 		std::cerr << color::blue << "If you are sure the setup file is not corrupted,"
 		          << " consider \nfiling a bug report at "
 		          << color::dim_cyan << innoextract_bugs << color::reset << '\n';
@@ -375,5 +567,9 @@ int main(int argc, char * argv[]) {
 		os << '.' << std::endl;
 	}
 	
+	if(stdout_buffer) {
+		std::cout.rdbuf(stdout_buffer);
+	}
+	
 	return logger::total_errors == 0 ? ExitSuccess : ExitDataError;
 }
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "cli/output.hpp"
+
+#include <stdexcept>
+
+#if INNOEXTRACT_OUTPUT_USE_DIRFD
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#else
+#include <boost/filesystem/operations.hpp>
+#endif
+
+#include <boost/foreach.hpp>
+
+#include "setup/filename.hpp"
+
+#if INNOEXTRACT_OUTPUT_USE_DIRFD
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+
+namespace {
+
+//! Limit for the number of open directory handles.
+const size_t max_directories = 256;
+
+} // anonymous namespace
+
+output_dir::output_dir(const boost::filesystem::path & dir) : root(dir) {
+	root_fd = ::open(dir.empty() ? "." : dir.string().c_str(),
+	                 O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(root_fd < 0) {
+		throw std::runtime_error("Could not open output directory \"" + dir.string() + '"');
+	}
+}
+
+output_dir::~output_dir() {
+	close_directories();
+	::close(root_fd);
+}
+
+void output_dir::close_directories() {
+	BOOST_FOREACH(const directory_map::value_type & entry, directories) {
+		::close(entry.second);
+	}
+	directories.clear();
+}
+
+int output_dir::open_directory(const std::string & path) {
+	
+	if(path.empty()) {
+		return root_fd;
+	}
+	
+	directory_map::const_iterator i = directories.find(path);
+	if(i != directories.end()) {
+		return i->second;
+	}
+	
+	int parent = root_fd;
+	std::string name = path;
+	size_t sep = path.find_last_of(setup::path_sep);
+	if(sep != std::string::npos) {
+		parent = open_directory(path.substr(0, sep));
+		if(parent < 0) {
+			return -1;
+		}
+		name = path.substr(sep + 1);
+	}
+	
+	if(::mkdirat(parent, name.c_str(), 0777) != 0 && errno != EEXIST) {
+		return -1;
+	}
+	int fd = ::openat(parent, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(fd < 0) {
+		return -1;
+	}
+	
+	if(directories.size() >= max_directories) {
+		// The parent handle is only needed until the new directory has been opened
+		close_directories();
+	}
+	directories[path] = fd;
+	
+	return fd;
+}
+
+output_file::output_file(output_dir & dir, const std::string & path)
+	: name(dir.root / path) {
+	
+	int parent = dir.root_fd;
+	std::string filename = path;
+	size_t sep = path.find_last_of(setup::path_sep);
+	if(sep != std::string::npos) {
+		parent = dir.open_directory(path.substr(0, sep));
+		if(parent < 0) {
+			throw std::runtime_error("Could not create directories for \""
+			                         + name.string() + '"');
+		}
+		filename = path.substr(sep + 1);
+	}
+	
+	fd = ::openat(parent, filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if(fd < 0) {
+		throw std::runtime_error("Could not open output file \"" + name.string() + '"');
+	}
+}
+
+output_file::~output_file() {
+	if(fd >= 0) {
+		::close(fd);
+	}
+}
+
+bool output_file::write(const char * data, size_t size) {
+	while(size) {
+		ssize_t n = ::write(fd, data, size);
+		if(n < 0 && errno == EINTR) {
+			continue;
+		} else if(n <= 0) {
+			return false;
+		}
+		data += n, size -= size_t(n);
+	}
+	return true;
+}
+
+bool output_file::close(util::time t, boost::uint32_t nsec) {
+	
+#if INNOEXTRACT_HAVE_FUTIMENS
+	
+	struct timespec times[2];
+	times[0].tv_sec = time_t(t);
+	times[0].tv_nsec = long(nsec);
+	times[1] = times[0];
+	bool success = (::futimens(fd, times) == 0);
+	
+	::close(fd);
+	fd = -1;
+	
+	return success;
+	
+#else
+	
+	::close(fd);
+	fd = -1;
+	
+	return util::set_file_time(name, t, nsec);
+	
+#endif
+}
+
+#else // !INNOEXTRACT_OUTPUT_USE_DIRFD
+
+output_dir::output_dir(const boost::filesystem::path & dir) : root(dir) { }
+
+output_dir::~output_dir() { }
+
+void output_dir::create_directory(const std::string & path) {
+	if(!path.empty() && directories.insert(path).second) {
+		boost::filesystem::create_directories(root / path);
+	}
+}
+
+output_file::output_file(output_dir & dir, const std::string & path)
+	: name(dir.root / path) {
+	
+	size_t sep = path.find_last_of(setup::path_sep);
+	if(sep != std::string::npos) {
+		try {
+			dir.create_directory(path.substr(0, sep));
+		} catch(...) {
+			throw std::runtime_error("Could not create directories for \""
+			                         + name.string() + '"');
+		}
+	}
+	
+	stream.open(name, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if(!stream.is_open()) {
+		throw std::runtime_error("Could not open output file \"" + name.string() + '"');
+	}
+}
+
+output_file::~output_file() { }
+
+bool output_file::write(const char * data, size_t size) {
+	stream.write(data, std::streamsize(size));
+	return !stream.fail();
+}
+
+bool output_file::close(util::time t, boost::uint32_t nsec) {
+	stream.close();
+	return util::set_file_time(name, t, nsec);
+}
+
+#endif // INNOEXTRACT_OUTPUT_USE_DIRFD
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Creation of extracted files in the output directory.
+ */
+#ifndef INNOEXTRACT_CLI_OUTPUT_HPP
+#define INNOEXTRACT_CLI_OUTPUT_HPP
+
+#include <stddef.h>
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "configure.hpp"
+
+#include "util/fstream.hpp"
+#include "util/time.hpp"
+
+#if INNOEXTRACT_HAVE_OPENAT && INNOEXTRACT_HAVE_MKDIRAT
+#define INNOEXTRACT_OUTPUT_USE_DIRFD 1
+#else
+#define INNOEXTRACT_OUTPUT_USE_DIRFD 0
+#endif
+
+/*!
+ * Directory that extracted files are written to.
+ *
+ * Where supported, handles for the directories containing output files are kept open so
+ * that files can be created relative to them without resolving the full path each time.
+ * Otherwise, directories that have already been created are remembered.
+ */
+class output_dir : private boost::noncopyable {
+	
+	boost::filesystem::path root;
+	
+#if INNOEXTRACT_OUTPUT_USE_DIRFD
+	typedef boost::unordered_map<std::string, int> directory_map;
+	directory_map directories; //!< Open directory handles indexed by relative path.
+	int root_fd;
+	void close_directories();
+#else
+	boost::unordered_set<std::string> directories; //!< Directories known to exist.
+#endif
+	
+	friend class output_file;
+	
+public:
+	
+	//! \param dir Existing directory to create files in.
+	explicit output_dir(const boost::filesystem::path & dir);
+	
+	~output_dir();
+	
+#if INNOEXTRACT_OUTPUT_USE_DIRFD
+	/*!
+	 * Get a handle for a subdirectory, creating it if needed.
+	 *
+	 * \param path Path of the directory relative to the output directory.
+	 *
+	 * \return the directory handle or \c -1 on error.
+	 */
+	int open_directory(const std::string & path);
+#else
+	/*!
+	 * Create a subdirectory and its parents if needed.
+	 *
+	 * \param path Path of the directory relative to the output directory.
+	 */
+	void create_directory(const std::string & path);
+#endif
+	
+};
+
+//! A file being extracted.
+class output_file : private boost::noncopyable {
+	
+	boost::filesystem::path name;
+	
+#if INNOEXTRACT_OUTPUT_USE_DIRFD
+	int fd;
+#else
+	util::ofstream stream;
+#endif
+	
+public:
+	
+	/*!
+	 * Create or truncate a file and any missing parent directories.
+	 *
+	 * \param dir  Output directory to create the file in.
+	 * \param path Path of the file relative to the output directory.
+	 *
+	 * \throws std::runtime_error if the file could not be created.
+	 */
+	output_file(output_dir & dir, const std::string & path);
+	
+	~output_file();
+	
+	//! Full path of the file, for messages.
+	const boost::filesystem::path & path() const { return name; }
+	
+	//! \return \c true if all data was written.
+	bool write(const char * data, size_t size);
+	
+	/*!
+	 * Set the access and modification times and close the file.
+	 *
+	 * \return \c true if the file times were set.
+	 */
+	bool close(util::time t, boost::uint32_t nsec);
+	
+};
+
+#endif // INNOEXTRACT_CLI_OUTPUT_HPP
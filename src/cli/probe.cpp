@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "cli/probe.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <sstream>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "loader/offsets.hpp"
+
+#include "setup/version.hpp"
+
+namespace fs = boost::filesystem;
+namespace io = boost::iostreams;
+
+namespace {
+
+//! Format the result record for a single file, without the filename.
+std::string probe_file(const std::string & file) {
+	
+	io::mapped_file_source mapping;
+	try {
+		mapping.open(file);
+	} catch(const std::exception &) {
+		try {
+			if(fs::is_regular_file(file) && fs::is_empty(file)) {
+				return "none"; // Empty files cannot be mapped
+			}
+		} catch(...) { }
+		return "error\tcould not open file";
+	}
+	if(!mapping.is_open()) {
+		return "error\tcould not open file";
+	}
+	
+	loader::offsets offsets;
+	offsets.find(mapping.data(), mapping.size());
+	if(offsets.header_offset >= mapping.size()) {
+		return "none";
+	}
+	
+	io::stream<io::array_source> is(mapping.data() + offsets.header_offset,
+	                                mapping.size() - offsets.header_offset);
+	setup::version version;
+	try {
+		version.load(is);
+	} catch(const setup::version_error &) {
+		return "none";
+	}
+	if(is.fail()) {
+		return "none";
+	}
+	
+	std::ostringstream oss;
+	oss << "inno\t" << version << '\t' << (offsets.data_offset ? "embedded" : "external");
+	return oss.str();
+}
+
+struct probe_state {
+	
+	const std::vector<std::string> & files;
+	
+	boost::mutex mutex;
+	boost::condition_variable finished;
+	
+	size_t next;                      //!< Next file to probe.
+	std::vector<std::string> results; //!< Records for files not yet printed.
+	std::vector<bool> done;
+	
+	explicit probe_state(const std::vector<std::string> & input)
+		: files(input), next(0), results(input.size()), done(input.size(), false) { }
+	
+};
+
+void probe_worker(probe_state & state) {
+	
+	for(;;) {
+		
+		size_t i;
+		{
+			boost::mutex::scoped_lock lock(state.mutex);
+			if(state.next == state.files.size()) {
+				return;
+			}
+			i = state.next++;
+		}
+		
+		std::string result = probe_file(state.files[i]);
+		
+		{
+			boost::mutex::scoped_lock lock(state.mutex);
+			state.results[i].swap(result);
+			state.done[i] = true;
+		}
+		state.finished.notify_one();
+	}
+}
+
+} // anonymous namespace
+
+size_t probe_files(const std::vector<std::string> & files) {
+	
+	probe_state state(files);
+	
+	size_t thread_count = std::max(boost::thread::hardware_concurrency(), 1u);
+	thread_count = std::min(thread_count, files.size());
+	
+	boost::thread_group threads;
+	for(size_t i = 0; i < thread_count; i++) {
+		threads.create_thread(boost::bind(probe_worker, boost::ref(state)));
+	}
+	
+	// Print results in order as soon as they are available
+	size_t errors = 0;
+	for(size_t i = 0; i < files.size(); i++) {
+		
+		std::string result;
+		{
+			boost::mutex::scoped_lock lock(state.mutex);
+			while(!state.done[i]) {
+				state.finished.wait(lock);
+			}
+			state.results[i].swap(result);
+		}
+		
+		if(result.compare(0, 6, "error\t") == 0) {
+			errors++;
+		}
+		std::cout << files[i] << '\t' << result << '\n';
+	}
+	std::cout.flush();
+	
+	threads.join_all();
+	
+	return errors;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Quick identification of setup files.
+ */
+#ifndef INNOEXTRACT_CLI_PROBE_HPP
+#define INNOEXTRACT_CLI_PROBE_HPP
+
+#include <string>
+#include <vector>
+
+/*!
+ * Check which files are setup files and print their setup data versions.
+ *
+ * Only the setup loader and the version identifier are read - files that are not
+ * supported or have corrupted headers may still be reported as setup files.
+ * Files are probed in parallel, but results are printed in the order of \c files, one
+ * line per file:
+ *
+ *   - <tt>\<file\>\\tinno\\t\<version\>\\t{embedded|external}</tt> for setup files
+ *   - <tt>\<file\>\\tnone</tt> for other files
+ *   - <tt>\<file\>\\terror\\t\<reason\></tt> if the file could not be read
+ *
+ * \return the number of files that could not be read.
+ */
+size_t probe_files(const std::vector<std::string> & files);
+
+#endif // INNOEXTRACT_CLI_PROBE_HPP
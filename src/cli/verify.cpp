@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "cli/verify.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "cli/journal.hpp"
+
+#include "crypto/hasher.hpp"
+
+#include "loader/plan.hpp"
+
+#include "setup/data.hpp"
+#include "setup/file.hpp"
+#include "setup/filter.hpp"
+#include "setup/info.hpp"
+
+#include "stream/file.hpp"
+
+#include "util/fstream.hpp"
+
+namespace fs = boost::filesystem;
+namespace io = boost::iostreams;
+
+namespace {
+
+//! Files smaller than this are read directly as mapping them costs more than reading.
+const boost::uint64_t map_threshold = boost::uint64_t(1) << 20;
+
+//! Amount of a file that is mapped at once.
+const boost::uint64_t map_window = boost::uint64_t(1) << 28;
+
+file_state verify_file(const fs::path & path, const stream::file & file) {
+	
+	util::ifstream ifs(path, std::ios_base::in | std::ios_base::binary);
+	if(!ifs.is_open()) {
+		try {
+			return fs::exists(path) ? FileUnreadable : FileMissing;
+		} catch(...) {
+			return FileMissing;
+		}
+	}
+	
+	ifs.seekg(0, std::ios_base::end);
+	std::streamoff end = ifs.tellg();
+	if(end < 0) {
+		return FileUnreadable;
+	}
+	boost::uint64_t size = boost::uint64_t(end);
+	if(size != file.size) {
+		return FileChanged;
+	}
+	
+	crypto::hasher checksum(file.checksum.type);
+	
+	if(size < map_threshold) {
+		ifs.seekg(0);
+		char buffer[8192 * 10];
+		while(ifs.read(buffer, std::streamsize(sizeof(buffer))) || ifs.gcount() > 0) {
+			checksum.update(buffer, size_t(ifs.gcount()));
+		}
+		if(ifs.bad()) {
+			return FileUnreadable;
+		}
+	} else {
+		ifs.close();
+		for(boost::uint64_t offset = 0; offset < size; offset += map_window) {
+			io::mapped_file_source mapping;
+			try {
+				mapping.open(path.string(), size_t(std::min(map_window, size - offset)),
+				             boost::intmax_t(offset));
+			} catch(const std::exception &) {
+				return FileUnreadable;
+			}
+			if(!mapping.is_open()) {
+				return FileUnreadable;
+			}
+			checksum.update(mapping.data(), mapping.size());
+		}
+	}
+	
+	return (checksum.finalize() == file.checksum) ? FileMatches : FileChanged;
+}
+
+struct verify_state {
+	
+	const fs::path & dir;
+	const setup::info & info;
+	
+	const std::vector<size_t> & files;
+	const std::vector<std::string> & paths;
+	
+	boost::mutex mutex;
+	
+	size_t next; //!< Next file to verify.
+	std::vector<file_state> & results;
+	
+	verify_state(const fs::path & dir, const setup::info & info,
+	             const std::vector<size_t> & files, const std::vector<std::string> & paths,
+	             std::vector<file_state> & results)
+		: dir(dir), info(info), files(files), paths(paths), next(0), results(results) { }
+	
+};
+
+void verify_worker(verify_state & state) {
+	
+	for(;;) {
+		
+		size_t i;
+		{
+			boost::mutex::scoped_lock lock(state.mutex);
+			if(state.next == state.files.size()) {
+				return;
+			}
+			i = state.next++;
+		}
+		
+		size_t file_index = state.files[i];
+		const setup::file_entry & entry = state.info.files[file_index];
+		const stream::file & file = state.info.data_entries[entry.location].file;
+		
+		// Each worker only writes its own results
+		state.results[i] = verify_file(state.dir / state.paths[file_index], file);
+	}
+}
+
+} // anonymous namespace
+
+void find_final_files(const loader::plan & plan, const std::vector<std::string> & paths,
+                      std::vector<bool> & final) {
+	
+	typedef boost::unordered_map<std::string, size_t> path_map;
+	path_map last_written;
+	
+	final.assign(paths.size(), false);
+	for(size_t i = 0; i < plan.chunks().size(); i++) {
+		if(plan.chunks()[i].encrypted) {
+			continue;
+		}
+		for(size_t j = plan.entries_begin(i); j < plan.entries_end(i); j++) {
+			size_t data_index = plan.entries()[j];
+			for(size_t k = plan.files_begin(data_index); k < plan.files_end(data_index); k++) {
+				size_t file_index = plan.files()[k];
+				path_map::value_type value(paths[file_index], file_index);
+				std::pair<path_map::iterator, bool> entry = last_written.insert(value);
+				if(!entry.second) {
+					final[entry.first->second] = false;
+					entry.first->second = file_index;
+				}
+				final[file_index] = true;
+			}
+		}
+	}
+}
+
+void verify_files(const fs::path & dir, const setup::info & info,
+                  const std::vector<size_t> & files, const std::vector<std::string> & paths,
+                  std::vector<file_state> & results) {
+	
+	results.assign(files.size(), FileMatches);
+	
+	verify_state state(dir, info, files, paths, results);
+	
+	size_t thread_count = std::max(boost::thread::hardware_concurrency(), 1u);
+	thread_count = std::min(thread_count, files.size());
+	
+	boost::thread_group threads;
+	for(size_t i = 0; i < thread_count; i++) {
+		threads.create_thread(boost::bind(verify_worker, boost::ref(state)));
+	}
+	threads.join_all();
+}
+
+void find_extra_files(const fs::path & dir, const std::vector<std::string> & paths,
+                      const setup::path_filter & includes, std::vector<std::string> & extra) {
+	
+	boost::unordered_set<std::string> expected;
+	BOOST_FOREACH(const std::string & path, paths) {
+		if(!path.empty()) {
+			expected.insert(path);
+		}
+	}
+	
+	extra.clear();
+	try {
+		// Prefix of the directory entry paths, including the trailing separator
+		std::string root = (dir / "x").string();
+		root.resize(root.size() - 1);
+		fs::recursive_directory_iterator end;
+		for(fs::recursive_directory_iterator i(dir); i != end; ++i) {
+			if(fs::is_directory(i->status())) {
+				continue;
+			}
+			std::string path = i->path().string().substr(root.size());
+			if(expected.find(path) != expected.end() || path == extract_journal::filename) {
+				continue;
+			}
+			if(includes.empty() || includes.match(path)) {
+				extra.push_back(path);
+			}
+		}
+	} catch(const fs::filesystem_error & e) {
+		throw std::runtime_error("Could not list directory \"" + dir.string() + "\": " + e.what());
+	}
+	
+	std::sort(extra.begin(), extra.end());
+}
+
+size_t verify_tree(const fs::path & dir, const setup::info & info, const loader::plan & plan,
+                   const std::vector<std::string> & paths, const setup::path_filter & includes) {
+	
+	try {
+		if(!fs::is_directory(dir)) {
+			throw std::runtime_error("Directory to verify does not exist: \"" + dir.string() + '"');
+		}
+	} catch(const fs::filesystem_error &) {
+		throw std::runtime_error("Could not access directory \"" + dir.string() + '"');
+	}
+	
+	// Check the files in the order they would be extracted
+	std::vector<bool> final;
+	find_final_files(plan, paths, final);
+	std::vector<size_t> files;
+	for(size_t j = 0; j < plan.entries().size(); j++) {
+		size_t data_index = plan.entries()[j];
+		for(size_t k = plan.files_begin(data_index); k < plan.files_end(data_index); k++) {
+			if(final[plan.files()[k]]) {
+				files.push_back(plan.files()[k]);
+			}
+		}
+	}
+	
+	std::vector<file_state> results;
+	verify_files(dir, info, files, paths, results);
+	
+	size_t problems = 0;
+	for(size_t i = 0; i < files.size(); i++) {
+		const char * kind = NULL;
+		switch(results[i]) {
+			case FileMatches: break;
+			case FileMissing: kind = "missing"; break;
+			case FileChanged: kind = "changed"; break;
+			case FileUnreadable: kind = "error"; break;
+		}
+		if(kind) {
+			std::cout << kind << '\t' << paths[files[i]] << '\n';
+			problems++;
+		}
+	}
+	
+	std::vector<std::string> extra;
+	find_extra_files(dir, paths, includes, extra);
+	BOOST_FOREACH(const std::string & path, extra) {
+		std::cout << "extra\t" << path << '\n';
+	}
+	problems += extra.size();
+	
+	std::cout.flush();
+	
+	return problems;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Verification of already extracted files against the checksums in the setup headers.
+ */
+#ifndef INNOEXTRACT_CLI_VERIFY_HPP
+#define INNOEXTRACT_CLI_VERIFY_HPP
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+namespace loader { class plan; }
+namespace setup { struct info; class path_filter; }
+
+//! State of an extracted file compared to its data entry.
+enum file_state {
+	FileMatches,
+	FileMissing,
+	FileChanged,   //!< The file size or checksum is different.
+	FileUnreadable,
+};
+
+/*!
+ * Determine which files determine the final contents of their output path.
+ *
+ * If a path is written by more than one file, only the last one in the plan is kept.
+ * Files in encrypted chunks are never written.
+ *
+ * \param plan  Plan for the selected files.
+ * \param paths Output path for each file entry.
+ * \param final Receives, for each file entry, whether its data ends up at its path.
+ */
+void find_final_files(const loader::plan & plan, const std::vector<std::string> & paths,
+                      std::vector<bool> & final);
+
+/*!
+ * Compare files in a directory against their data entries.
+ *
+ * The files are checked in parallel. Files smaller than 1 MiB are read directly, larger
+ * files are hashed through memory mappings.
+ *
+ * \param dir     Directory the files were extracted to.
+ * \param info    Setup headers including the file and data entries.
+ * \param files   Indices of the \ref setup::info::files to check.
+ * \param paths   Output path for each file entry.
+ * \param results Receives the state for each of \c files.
+ */
+void verify_files(const boost::filesystem::path & dir, const setup::info & info,
+                  const std::vector<size_t> & files, const std::vector<std::string> & paths,
+                  std::vector<file_state> & results);
+
+/*!
+ * Find files in a directory that are not part of the installer.
+ *
+ * \param dir      Directory the files were extracted to.
+ * \param paths    Output path for each file entry, or an empty string for files that
+ *                 were not selected.
+ * \param includes Filter that unexpected files must match in order to be reported.
+ * \param extra    Receives the sorted paths of files in \c dir not listed in \c paths.
+ *
+ * \throws std::runtime_error if the directory could not be listed.
+ */
+void find_extra_files(const boost::filesystem::path & dir,
+                      const std::vector<std::string> & paths,
+                      const setup::path_filter & includes, std::vector<std::string> & extra);
+
+/*!
+ * Compare an extracted directory against the checksums stored in the installer.
+ *
+ * The files are hashed in parallel using memory mappings - the setup data is not read.
+ * For each problem found, a tab-separated line with the kind of problem ("missing",
+ * "changed", "error" or "extra") and the path is printed to stdout.
+ *
+ * \param dir      Directory the files were extracted to.
+ * \param info     Setup headers including the file and data entries.
+ * \param plan     Plan for the selected files, in the order they would be extracted.
+ * \param paths    Output path for each file entry.
+ * \param includes Filter that unexpected files must match in order to be reported.
+ *
+ * \return the number of problems found.
+ *
+ * \throws std::runtime_error if the directory does not exist.
+ */
+size_t verify_tree(const boost::filesystem::path & dir, const setup::info & info,
+                   const loader::plan & plan, const std::vector<std::string> & paths,
+                   const setup::path_filter & includes);
+
+#endif // INNOEXTRACT_CLI_VERIFY_HPP
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "loader/cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "loader/installer.hpp"
+
+#include "setup/data.hpp"
+#include "setup/file.hpp"
+
+#include "stream/chunk.hpp"
+#include "stream/file.hpp"
+#include "stream/slice.hpp"
+
+#include "util/boostfs_compat.hpp"
+#include "util/fstream.hpp"
+#include "util/load.hpp"
+#include "util/unique_ptr.hpp"
+
+namespace loader {
+
+//! A chunk decoder positioned somewhere inside a chunk.
+struct cached_reader::decoder {
+	
+	util::ifstream ifs;
+	boost::scoped_ptr<stream::slice_reader> slices;
+	
+	stream::chunk chunk;
+	stream::chunk_reader::pointer chunk_source;
+	boost::uint64_t position; //!< Position in the chunk after the end of the current file.
+	
+	size_t data_index;                        //!< Data entry read by file_source.
+	stream::file_reader::pointer file_source;
+	boost::uint64_t file_position;            //!< Position in the current file.
+	
+	boost::uint64_t memory; //!< Memory reserved for decoding the current chunk.
+	
+	decoder() : position(0), data_index(size_t(-1)), file_position(0), memory(0) { }
+	
+	~decoder() {
+		file_source.reset();
+		chunk_source.reset();
+	}
+	
+	/*!
+	 * Check if this decoder can reach the given file offset without restarting.
+	 *
+	 * \return the amount of data that would need to be decoded or \c -1 if the offset
+	 *         cannot be reached.
+	 */
+	boost::uint64_t distance(const setup::data_entry & data, size_t index,
+	                         boost::uint64_t offset) const {
+		if(!chunk_source || !(data.chunk == chunk)) {
+			return boost::uint64_t(-1);
+		}
+		if(file_source && index == data_index) {
+			return (offset >= file_position) ? offset - file_position : boost::uint64_t(-1);
+		}
+		if(data.file.offset < position) {
+			return boost::uint64_t(-1);
+		}
+		return data.file.offset - position + offset;
+	}
+	
+	//! Open the setup file or slice files if not already done.
+	void open(const installer & setup) {
+		
+		if(slices) {
+			return;
+		}
+		
+		if(setup.offsets.data_offset) {
+			ifs.open(setup.file, std::ios_base::in | std::ios_base::binary);
+			if(!ifs.is_open()) {
+				throw std::runtime_error("Could not open file \"" + setup.file.string() + '"');
+			}
+			slices.reset(new stream::slice_reader(&ifs, setup.offsets.data_offset));
+		} else {
+			std::string basename = util::as_string(setup.file.stem());
+			slices.reset(new stream::slice_reader(setup.file.parent_path(), basename,
+			                                      setup.info.header.slices_per_disk));
+		}
+	}
+	
+	/*!
+	 * Estimate the memory needed to decode a chunk.
+	 * This stops decoding the current chunk.
+	 */
+	boost::uint64_t memory_usage(const installer & setup, const stream::chunk & target) {
+		file_source.reset();
+		chunk_source.reset();
+		open(setup);
+		return stream::chunk_reader::memory_usage(*slices, target);
+	}
+	
+	//! Position the decoder in a file at or before the given offset.
+	void seek(const installer & setup, size_t index, boost::uint64_t offset) {
+		
+		const setup::data_entry & data = setup.info.data_entries[index];
+		
+		if(file_source && index == data_index && file_position <= offset) {
+			return;
+		}
+		
+		if(chunk_source && data.chunk == chunk && data.file.offset >= position) {
+			if(file_source) {
+				// Skip the rest of the previous file
+				file_source->clear();
+				char buffer[8192];
+				while(file_source->read(buffer, std::streamsize(sizeof(buffer))).gcount()) { }
+			}
+		} else {
+			
+			file_source.reset();
+			chunk_source.reset();
+			
+			open(setup);
+			
+			chunk = data.chunk;
+			position = 0;
+			chunk_source = stream::chunk_reader::get(*slices, chunk);
+			
+		}
+		file_source.reset();
+		
+		if(data.file.offset > position) {
+			util::discard(*chunk_source, data.file.offset - position);
+		}
+		position = data.file.offset + data.file.size;
+		
+		file_source = stream::file_reader::get(*chunk_source, data.file, NULL);
+		data_index = index;
+		file_position = 0;
+	}
+	
+	//! Decode the next block of the current file.
+	void next(std::vector<char> & buffer, boost::uint64_t file_size) {
+		
+		size_t size = size_t(std::min<boost::uint64_t>(block_size, file_size - file_position));
+		buffer.resize(size);
+		
+		if(size) {
+			file_source->read(&buffer.front(), std::streamsize(size));
+			if(size_t(file_source->gcount()) != size) {
+				throw std::ios_base::failure("Unexpected end of file data");
+			}
+		}
+		
+		file_position += size;
+	}
+	
+};
+
+const size_t cached_reader::block_size;
+
+cached_reader::cached_reader(const installer & setup, size_t max_size, size_t max_decoders,
+                             boost::uint64_t max_memory)
+	: setup(setup), max_size(max_size), max_decoders(max_decoders), max_memory(max_memory),
+	  memory_used(0), cached_size(0) { }
+
+cached_reader::~cached_reader() {
+	BOOST_FOREACH(decoder * d, parked) {
+		delete d;
+	}
+}
+
+bool cached_reader::lookup(const block_key & key, boost::uint64_t offset, char * buffer,
+                           size_t size) {
+	
+	boost::mutex::scoped_lock lock(mutex);
+	
+	block_map::iterator i = blocks.find(key);
+	if(i == blocks.end()) {
+		return false;
+	}
+	
+	lru.splice(lru.end(), lru, i->second.lru);
+	
+	std::memcpy(buffer, &i->second.data[size_t(offset)], size);
+	
+	return true;
+}
+
+void cached_reader::insert(const block_key & key, const std::vector<char> & data) {
+	
+	if(data.size() > max_size) {
+		return;
+	}
+	
+	boost::mutex::scoped_lock lock(mutex);
+	
+	if(blocks.find(key) != blocks.end()) {
+		return; // Decoded concurrently by another reader
+	}
+	
+	while(cached_size + data.size() > max_size) {
+		block_map::iterator oldest = blocks.find(lru.front());
+		cached_size -= oldest->second.data.size();
+		blocks.erase(oldest);
+		lru.pop_front();
+	}
+	
+	block & entry = blocks[key];
+	entry.data = data;
+	entry.lru = lru.insert(lru.end(), key);
+	cached_size += data.size();
+}
+
+cached_reader::decoder * cached_reader::acquire(size_t data_index, boost::uint64_t offset) {
+	
+	const setup::data_entry & data = setup.info.data_entries[data_index];
+	
+	boost::mutex::scoped_lock lock(mutex);
+	
+	// Use the decoder that needs to skip the least amount of data
+	std::list<decoder *>::iterator best = parked.end();
+	boost::uint64_t best_distance = boost::uint64_t(-1);
+	for(std::list<decoder *>::iterator i = parked.begin(); i != parked.end(); ++i) {
+		boost::uint64_t distance = (*i)->distance(data, data_index, offset);
+		if(distance < best_distance) {
+			best = i, best_distance = distance;
+		}
+	}
+	
+	if(best != parked.end()) {
+		decoder * d = *best;
+		parked.erase(best);
+		return d;
+	}
+	
+	// Re-use the least recently used decoder to keep its open slice files
+	if(!parked.empty() && parked.size() >= max_decoders) {
+		decoder * d = parked.front();
+		parked.pop_front();
+		return d;
+	}
+	
+	return new decoder;
+}
+
+void cached_reader::park(decoder * d) {
+	
+	boost::mutex::scoped_lock lock(mutex);
+	
+	parked.push_back(d);
+	
+	if(parked.size() > max_decoders) {
+		memory_used -= parked.front()->memory;
+		delete parked.front();
+		parked.pop_front();
+	}
+	
+	// Idle decoders can be freed by readers waiting for memory
+	memory_freed.notify_all();
+}
+
+void cached_reader::admit(decoder & d, size_t data_index) {
+	
+	if(!max_memory) {
+		return;
+	}
+	
+	const stream::chunk & chunk = setup.info.data_entries[data_index].chunk;
+	boost::uint64_t needed = d.memory_usage(setup, chunk);
+	
+	boost::mutex::scoped_lock lock(mutex);
+	
+	memory_used -= d.memory;
+	d.memory = 0;
+	memory_freed.notify_all();
+	
+	// Chunks that don't fit into the budget at all must wait until they can run alone
+	while(memory_used && memory_used + needed > max_memory) {
+		if(!parked.empty()) {
+			memory_used -= parked.front()->memory;
+			delete parked.front();
+			parked.pop_front();
+		} else {
+			memory_freed.wait(lock);
+		}
+	}
+	
+	memory_used += needed;
+	d.memory = needed;
+}
+
+void cached_reader::release(decoder * d) {
+	
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		memory_used -= d->memory;
+		memory_freed.notify_all();
+	}
+	
+	delete d;
+}
+
+size_t cached_reader::read(size_t file_index, boost::uint64_t offset, char * buffer,
+                           size_t size) {
+	
+	if(file_index >= setup.info.files.size()
+	   || setup.info.files[file_index].location >= setup.info.data_entries.size()) {
+		throw std::out_of_range("Invalid file index");
+	}
+	size_t data_index = setup.info.files[file_index].location;
+	const setup::data_entry & data = setup.info.data_entries[data_index];
+	
+	if(data.chunk.encrypted) {
+		throw stream::chunk_error("Encrypted chunks are not supported");
+	}
+	
+	if(offset >= data.file.size) {
+		return 0;
+	}
+	size = size_t(std::min<boost::uint64_t>(size, data.file.size - offset));
+	
+	util::unique_ptr<decoder>::type d;
+	std::vector<char> decoded;
+	
+	size_t done = 0;
+	try {
+		while(done < size) {
+			
+			boost::uint64_t position = offset + done;
+			boost::uint64_t index = position / block_size;
+			boost::uint64_t block_offset = position % block_size;
+			size_t n = size_t(std::min<boost::uint64_t>(size - done, block_size - block_offset));
+			
+			block_key key(data_index, index);
+			if(!lookup(key, block_offset, buffer + done, n)) {
+				
+				boost::uint64_t start = index * block_size;
+				if(!d.get() || d->distance(data, data_index, start) == boost::uint64_t(-1)) {
+					if(d.get()) {
+						park(d.release());
+					}
+					d.reset(acquire(data_index, start));
+				}
+				
+				if(d->distance(data, data_index, start) == boost::uint64_t(-1)) {
+					// The decoder needs to start a new chunk
+					admit(*d, data_index);
+				}
+				
+				// Decode up to the needed block, caching everything along the way
+				d->seek(setup, data_index, start);
+				while(d->file_position <= start) {
+					key.second = d->file_position / block_size;
+					d->next(decoded, data.file.size);
+					insert(key, decoded);
+				}
+				
+				std::memcpy(buffer + done, &decoded[size_t(block_offset)], n);
+			}
+			
+			done += n;
+		}
+	} catch(...) {
+		// Don't re-use decoders in an unknown state
+		if(d.get()) {
+			release(d.release());
+		}
+		throw;
+	}
+	
+	if(d.get()) {
+		park(d.release());
+	}
+	
+	return done;
+}
+
+} // namespace loader
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Random access to file data with caching of decompressed data.
+ */
+#ifndef INNOEXTRACT_LOADER_CACHE_HPP
+#define INNOEXTRACT_LOADER_CACHE_HPP
+
+#include <stddef.h>
+#include <list>
+#include <utility>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace loader {
+
+class installer;
+
+/*!
+ * Reader for arbitrary byte ranges of the files in a setup file.
+ *
+ * Data is stored in solid compressed chunks that can only be decoded from the start.
+ * To avoid decoding the same data over and over, decoded file data is kept in a
+ * size-limited LRU cache of fixed-size blocks. In addition, decoders are parked at their
+ * current position after each read so that reads further into the same chunk can
+ * continue where the last read stopped.
+ *
+ * All public member functions may be called concurrently from multiple threads.
+ * Each concurrent reader that misses the cache uses its own decoder.
+ * If a memory budget is set, decoders only start on a new chunk once the estimated
+ * memory usage of all decoders fits into that budget. Chunks that need more memory than
+ * the budget allows are only decoded while no other decoder is using memory.
+ * The budget is only enforced when admitting decoders, based on the decoder memory
+ * estimated from the chunk headers - the decoders themselves are not limited.
+ *
+ * Checksums are not verified when reading.
+ */
+class cached_reader : private boost::noncopyable {
+	
+	struct decoder;
+	
+	typedef std::pair<size_t, boost::uint64_t> block_key; //!< Data entry and block index.
+	typedef std::list<block_key> lru_list;
+	
+	struct block {
+		std::vector<char> data;
+		lru_list::iterator lru;
+	};
+	
+	typedef boost::unordered_map<block_key, block> block_map;
+	
+	const installer & setup;
+	
+	const size_t max_size;
+	const size_t max_decoders;
+	const boost::uint64_t max_memory;
+	
+	boost::mutex mutex; //!< Protects all members below.
+	
+	boost::uint64_t memory_used;             //!< Memory reserved by all decoders.
+	boost::condition_variable memory_freed;
+	
+	block_map blocks;
+	lru_list lru;        //!< Cached blocks, least recently used first.
+	size_t cached_size;  //!< Total size of the data in \ref blocks.
+	
+	std::list<decoder *> parked; //!< Idle decoders, least recently used first.
+	
+	bool lookup(const block_key & key, boost::uint64_t offset, char * buffer, size_t size);
+	void insert(const block_key & key, const std::vector<char> & data);
+	decoder * acquire(size_t data_index, boost::uint64_t offset);
+	void park(decoder * d);
+	void admit(decoder & d, size_t data_index);
+	void release(decoder * d);
+	
+public:
+	
+	//! Size of the cached blocks.
+	static const size_t block_size = 64 * 1024;
+	
+	/*!
+	 * \param setup        The opened setup file. Must outlive the reader.
+	 * \param max_size     Maximum amount of decoded data to cache, in bytes.
+	 * \param max_decoders Maximum number of idle decoders to keep.
+	 * \param max_memory   Memory budget for all decoders, in bytes, or \c 0 for no limit.
+	 */
+	explicit cached_reader(const installer & setup, size_t max_size = 64 * 1024 * 1024,
+	                       size_t max_decoders = 4, boost::uint64_t max_memory = 0);
+	
+	~cached_reader();
+	
+	/*!
+	 * Read part of a file.
+	 *
+	 * \param file_index Index into \ref setup::info::files.
+	 * \param offset     Offset within the file to start reading at.
+	 * \param buffer     Buffer to store the data in.
+	 * \param size       Number of bytes to read.
+	 *
+	 * \throws std::out_of_range       if there is no file with data for the given index.
+	 * \throws std::ios_base::failure  if the data could not be read.
+	 *
+	 * \return the number of bytes read. This is less than \c size only if the end of the
+	 *         file has been reached.
+	 */
+	size_t read(size_t file_index, boost::uint64_t offset, char * buffer, size_t size);
+	
+};
+
+} // namespace loader
+
+#endif // INNOEXTRACT_LOADER_CACHE_HPP
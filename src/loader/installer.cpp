@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "loader/installer.hpp"
+
+#include <stdexcept>
+
+#include <boost/foreach.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/range/size.hpp>
+
+#include "setup/data.hpp"
+#include "setup/file.hpp"
+
+#include "stream/slice.hpp"
+
+#include "util/boostfs_compat.hpp"
+#include "util/load.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace loader {
+
+installer::installer(const fs::path & file, setup::info::entry_types entries)
+	: file(file), position(0) {
+	
+	bool is_directory;
+	try {
+		is_directory = fs::is_directory(file);
+	} catch(...) {
+		throw std::runtime_error("Could not open file \"" + file.string()
+		                         + "\": access denied");
+	}
+	if(is_directory) {
+		throw std::runtime_error("Input file \"" + file.string() + "\" is a directory!");
+	}
+	
+	ifs.open(file, std::ios_base::in | std::ios_base::binary);
+	if(!ifs.is_open()) {
+		throw std::runtime_error("Could not open file \"" + file.string() + '"');
+	}
+	
+	offsets.load(ifs);
+	
+	ifs.seekg(offsets.header_offset);
+	info.load(ifs, entries);
+	
+	BOOST_FOREACH(setup::data_entry & location, info.data_entries) {
+		if(location.chunk.compression == stream::UnknownCompression) {
+			location.chunk.compression = info.header.compression;
+		}
+	}
+}
+
+installer::~installer() {
+	// The streams reference each other - destroy them in order
+	file_source.reset();
+	chunk_source.reset();
+}
+
+stream::file_reader::type & installer::open(size_t data_index, crypto::checksum * checksum) {
+	
+	if(data_index >= info.data_entries.size()) {
+		throw std::out_of_range("Invalid data entry index");
+	}
+	const setup::data_entry & data = info.data_entries[data_index];
+	
+	if(data.chunk.encrypted) {
+		throw stream::chunk_error("Encrypted chunks are not supported");
+	}
+	
+	if(chunk_source && data.chunk == chunk && data.file.offset >= position) {
+		
+		// Continue reading the current chunk after the end of the previous file
+		if(file_source) {
+			file_source->clear();
+			char buffer[8192];
+			while(file_source->read(buffer, std::streamsize(boost::size(buffer))).gcount()) { }
+		}
+		
+	} else {
+		
+		file_source.reset();
+		chunk_source.reset();
+		
+		if(!slices) {
+			if(offsets.data_offset) {
+				slices.reset(new stream::slice_reader(&ifs, offsets.data_offset));
+			} else {
+				std::string basename = util::as_string(file.stem());
+				slices.reset(new stream::slice_reader(file.parent_path(), basename,
+				                                      info.header.slices_per_disk));
+			}
+		}
+		
+		chunk = data.chunk;
+		position = 0;
+		chunk_source = stream::chunk_reader::get(*slices, chunk);
+		
+	}
+	file_source.reset();
+	
+	if(data.file.offset > position) {
+		util::discard(*chunk_source, data.file.offset - position);
+	}
+	position = data.file.offset + data.file.size;
+	
+	file_source = stream::file_reader::get(*chunk_source, data.file, checksum);
+	
+	return *file_source;
+}
+
+bool installer::extract(size_t data_index, std::ostream & os) {
+	
+	crypto::checksum checksum;
+	stream::file_reader::type & is = open(data_index, &checksum);
+	
+	while(!is.eof()) {
+		char buffer[8192 * 10];
+		std::streamsize n = is.read(buffer, std::streamsize(boost::size(buffer))).gcount();
+		if(n > 0) {
+			os.write(buffer, n);
+			if(os.fail()) {
+				throw std::ios_base::failure("Error writing file data");
+			}
+		}
+	}
+	
+	return checksum == info.data_entries[data_index].file.checksum;
+}
+
+} // namespace loader
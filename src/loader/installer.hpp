@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * High-level interface to read the contents of a setup file.
+ */
+#ifndef INNOEXTRACT_LOADER_INSTALLER_HPP
+#define INNOEXTRACT_LOADER_INSTALLER_HPP
+
+#include <stddef.h>
+#include <ostream>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "loader/offsets.hpp"
+#include "setup/info.hpp"
+#include "stream/chunk.hpp"
+#include "stream/file.hpp"
+#include "util/fstream.hpp"
+
+namespace stream { class slice_reader; }
+
+namespace loader {
+
+/*!
+ * An opened setup file.
+ *
+ * Loads the setup headers on construction and provides streams for the file data
+ * referenced by \ref setup::data_entry "data entries".
+ *
+ * Warnings about unexpected data are reported through the process-wide \ref logger,
+ * both while loading and while reading the returned streams. They are written to the
+ * console unless a sink has been installed with \ref logger::set_sink. The sink is
+ * shared by all installers, so warnings cannot be attributed to a specific one.
+ *
+ * Data streams are read from a single shared decompressor: opening a new stream
+ * invalidates the previous one. Reading entries in the order of their
+ * \ref stream::file::offset "offsets" within each chunk avoids decompressing any data
+ * more than once.
+ */
+class installer : private boost::noncopyable {
+	
+	friend class cached_reader;
+	
+	boost::filesystem::path file;
+	util::ifstream ifs;
+	
+	boost::scoped_ptr<stream::slice_reader> slices;
+	
+	stream::chunk chunk;                        //!< Chunk read by \ref chunk_source.
+	stream::chunk_reader::pointer chunk_source; //!< Decompressor for the current chunk.
+	boost::uint64_t position;                   //!< Position of chunk_source in the chunk.
+	
+	stream::file_reader::pointer file_source;   //!< Last stream returned by \ref open.
+	
+public:
+	
+	loader::offsets offsets; //!< Location of the setup data in the setup file.
+	setup::info info;        //!< Loaded setup headers.
+	
+	/*!
+	 * Open a setup file and load its headers.
+	 *
+	 * \param file    The setup executable. External slices are expected in the same
+	 *                directory.
+	 * \param entries What kinds of entries to load.
+	 *
+	 * \throws std::runtime_error         if the file could not be opened.
+	 * \throws setup::version_error       if the file is not a supported setup file.
+	 * \throws std::ios_base::failure     if the setup headers are corrupted.
+	 */
+	explicit installer(const boost::filesystem::path & file,
+	                   setup::info::entry_types entries
+	                   = setup::info::entry_types(setup::info::DataEntries)
+	                   | setup::info::Files);
+	
+	~installer();
+	
+	/*!
+	 * Open the data for a data entry.
+	 *
+	 * File entries reference their data using \ref setup::file_entry::location.
+	 *
+	 * \param data_index Index into \ref setup::info::data_entries.
+	 * \param checksum   Optional checksum that is updated as the data is read.
+	 *
+	 * \throws std::out_of_range       if there is no data entry with the given index.
+	 * \throws std::ios_base::failure  if the data could not be read.
+	 *
+	 * \return a non-seekable stream for the decompressed file data that is valid until the
+	 *         next call to \ref open or \ref extract.
+	 */
+	stream::file_reader::type & open(size_t data_index, crypto::checksum * checksum = NULL);
+	
+	/*!
+	 * Copy the data for a data entry to an output stream and verify its checksum.
+	 *
+	 * \param data_index Index into \ref setup::info::data_entries.
+	 * \param os         Stream to write the data to.
+	 *
+	 * \throws std::out_of_range       if there is no data entry with the given index.
+	 * \throws std::ios_base::failure  if the data could not be read or written.
+	 *
+	 * \return \c true if the data matches the stored checksum.
+	 */
+	bool extract(size_t data_index, std::ostream & os);
+	
+};
+
+} // namespace loader
+
+#endif // INNOEXTRACT_LOADER_INSTALLER_HPP
@@ -24,6 +24,8 @@
 
 #include <boost/cstdint.hpp>
 #include <boost/static_assert.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
 #include <boost/range/size.hpp>
 
 #include <stddef.h>
@@ -63,7 +65,7 @@ const boost::uint32_t SetupLoaderHeaderMagic = 0x6f6e6e49;
 
 } // anonymous namespace
 
-bool offsets::load_from_exe_file(std::istream & is) {
+bool offsets::load_from_exe_file(std::istream & is, bool report_errors) {
 	
 	is.seekg(SetupLoaderHeaderOffset);
 	
@@ -80,10 +82,10 @@ bool offsets::load_from_exe_file(std::istream & is) {
 		return false;
 	}
 	
-	return load_offsets_at(is, offset_table_offset);
+	return load_offsets_at(is, offset_table_offset, report_errors);
 }
 
-bool offsets::load_from_exe_resource(std::istream & is) {
+bool offsets::load_from_exe_resource(std::istream & is, bool report_errors) {
 	
 	exe_reader::resource resource = exe_reader::find_resource(is, ResourceNameInstaller);
 	if(!resource) {
@@ -91,10 +93,10 @@ bool offsets::load_from_exe_resource(std::istream & is) {
 		return false;
 	}
 	
-	return load_offsets_at(is, resource.offset);
+	return load_offsets_at(is, resource.offset, report_errors);
 }
 
-bool offsets::load_offsets_at(std::istream & is, boost::uint32_t pos) {
+bool offsets::load_offsets_at(std::istream & is, boost::uint32_t pos, bool report_errors) {
 	
 	if(is.seekg(pos).fail()) {
 		is.clear();
@@ -171,7 +173,9 @@ bool offsets::load_offsets_at(std::istream & is, boost::uint32_t pos) {
 			return false;
 		}
 		if(checksum.finalize() != expected) {
-			log_error << "Loader checksum mismatch!";
+			if(report_errors) {
+				log_error << "Loader checksum mismatch!";
+			}
 			return false;
 		}
 	}
@@ -201,6 +205,29 @@ void offsets::load(std::istream & is) {
 	 * If no offset table has been found, this must be an external setup-0.bin file.
 	 * In that case, the setup headers start at the beginning of the file.
 	 */
+	set_defaults();
+}
+
+bool offsets::find(const char * data, size_t size) {
+	
+	boost::iostreams::stream<boost::iostreams::array_source> is(data, size);
+	
+	if(load_from_exe_file(is, false)) {
+		return true;
+	}
+	
+	// Only the PE headers and resource tree are read, so files that are not installers
+	// are rejected without touching most of their pages
+	if(load_from_exe_resource(is, false)) {
+		return true;
+	}
+	
+	set_defaults();
+	
+	return false;
+}
+
+void offsets::set_defaults() {
 	
 	exe_compressed_size = exe_uncompressed_size = exe_offset = 0; // No embedded setup exe.
 	
@@ -26,6 +26,7 @@
 #ifndef INNOEXTRACT_LOADER_OFFSETS_HPP
 #define INNOEXTRACT_LOADER_OFFSETS_HPP
 
+#include <stddef.h>
 #include <iosfwd>
 
 #include <boost/cstdint.hpp>
@@ -117,13 +118,30 @@ struct offsets {
 	 */
 	void load(std::istream & is);
 	
+	/*!
+	 * \brief Quickly find the setup loader offsets in a file that has been read into memory
+	 *
+	 * The file is read through the existing mapping instead of a file stream.
+	 * No errors are logged, making this safe to use from multiple threads.
+	 *
+	 * If no offset table is found, the offsets are set as in \ref load.
+	 *
+	 * \param data The contents of the main installer file.
+	 * \param size The size of the file.
+	 *
+	 * \return \c true if an offset table was found.
+	 */
+	bool find(const char * data, size_t size);
+	
 private:
 	
-	bool load_from_exe_file(std::istream & is);
+	bool load_from_exe_file(std::istream & is, bool report_errors = true);
+	
+	bool load_from_exe_resource(std::istream & is, bool report_errors = true);
 	
-	bool load_from_exe_resource(std::istream & is);
+	bool load_offsets_at(std::istream & is, boost::uint32_t pos, bool report_errors = true);
 	
-	bool load_offsets_at(std::istream & is, boost::uint32_t pos);
+	void set_defaults();
 	
 };
 
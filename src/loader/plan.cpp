@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "loader/plan.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <string>
+
+#include <boost/foreach.hpp>
+
+#include "setup/data.hpp"
+#include "setup/file.hpp"
+#include "setup/info.hpp"
+#include "util/endian.hpp"
+#include "util/load.hpp"
+
+namespace loader {
+
+namespace {
+
+//! Identifier and format version of saved plans.
+const char plan_magic[8] = { 'i', 'n', 'n', 'o', 'p', 'l', 'a', 'n' };
+const boost::uint32_t plan_format = 1;
+
+/*!
+ * Stable radix sort of data entry indices, one byte of the key at a time.
+ *
+ * \param order  The indices to sort.
+ * \param buffer Scratch space - resized as needed.
+ * \param keys   Sort key for each data entry index.
+ */
+void radix_sort(std::vector<boost::uint32_t> & order, std::vector<boost::uint32_t> & buffer,
+                const std::vector<boost::uint64_t> & keys) {
+	
+	boost::uint64_t max_key = 0;
+	for(size_t i = 0; i < order.size(); i++) {
+		max_key = std::max(max_key, keys[order[i]]);
+	}
+	
+	buffer.resize(order.size());
+	
+	for(unsigned shift = 0; shift < 64 && (max_key >> shift) != 0; shift += 8) {
+		
+		size_t count[256] = { 0 };
+		for(size_t i = 0; i < order.size(); i++) {
+			count[(keys[order[i]] >> shift) & 0xff]++;
+		}
+		if(std::find(count, count + 256, order.size()) != count + 256) {
+			continue; // All keys have the same digit
+		}
+		
+		size_t position = 0;
+		for(size_t digit = 0; digit < 256; digit++) {
+			size_t n = count[digit];
+			count[digit] = position;
+			position += n;
+		}
+		for(size_t i = 0; i < order.size(); i++) {
+			buffer[count[(keys[order[i]] >> shift) & 0xff]++] = order[i];
+		}
+		
+		order.swap(buffer);
+	}
+}
+
+//! Sort data entry indices by the position of the file data in the setup data.
+void sort_entries(const setup::info & info, std::vector<boost::uint32_t> & order) {
+	
+	std::vector<boost::uint64_t> keys(info.data_entries.size());
+	std::vector<boost::uint32_t> buffer;
+	
+	// Least significant key first - each pass keeps the order of the previous ones for
+	// entries with the same key.
+	
+	for(size_t i = 0; i < keys.size(); i++) {
+		keys[i] = info.data_entries[i].file.size;
+	}
+	radix_sort(order, buffer, keys);
+	
+	for(size_t i = 0; i < keys.size(); i++) {
+		keys[i] = info.data_entries[i].file.offset;
+	}
+	radix_sort(order, buffer, keys);
+	
+	for(size_t i = 0; i < keys.size(); i++) {
+		keys[i] = info.data_entries[i].chunk.offset;
+	}
+	radix_sort(order, buffer, keys);
+	
+	for(size_t i = 0; i < keys.size(); i++) {
+		keys[i] = info.data_entries[i].chunk.first_slice;
+	}
+	radix_sort(order, buffer, keys);
+}
+
+template <class T>
+void store(std::string & out, T value) {
+	char buffer[sizeof(T)];
+	util::little_endian::store(value, buffer);
+	out.append(buffer, sizeof(buffer));
+}
+
+void store_indices(std::string & out, const std::vector<boost::uint32_t> & values) {
+	store(out, boost::uint32_t(values.size()));
+	size_t start = out.size();
+	out.resize(start + values.size() * sizeof(boost::uint32_t));
+	if(!values.empty()) {
+		util::little_endian::store(&values.front(), values.size(), &out[start]);
+	}
+}
+
+void load_indices(util::span_reader & is, std::vector<boost::uint32_t> & values) {
+	
+	size_t count = util::load<boost::uint32_t>(is);
+	if(count > is.remaining() / sizeof(boost::uint32_t)) {
+		throw std::ios_base::failure("truncated plan");
+	}
+	
+	values.resize(count);
+	if(count) {
+		util::little_endian::load(is.take(count * sizeof(boost::uint32_t)), &values.front(),
+		                          count);
+	}
+}
+
+//! Check that a list of range starts is valid for a list of the given size.
+void check_ranges(const std::vector<boost::uint32_t> & ranges, size_t count, size_t size) {
+	if(ranges.size() != count + 1 || ranges.front() != 0 || ranges.back() != size) {
+		throw std::ios_base::failure("plan does not match setup headers");
+	}
+	for(size_t i = 0; i < count; i++) {
+		if(ranges[i] > ranges[i + 1]) {
+			throw std::ios_base::failure("invalid range in plan");
+		}
+	}
+}
+
+} // anonymous namespace
+
+void plan::build(const setup::info & info, const std::vector<bool> & selected) {
+	
+	size_t location_count = info.data_entries.size();
+	
+	// Index the selected files by their data entry
+	location_files.assign(location_count + 1, 0);
+	for(size_t i = 0; i < info.files.size() && i < selected.size(); i++) {
+		if(selected[i] && info.files[i].location < location_count) {
+			location_files[info.files[i].location + 1]++;
+		}
+	}
+	for(size_t i = 0; i < location_count; i++) {
+		location_files[i + 1] += location_files[i];
+	}
+	file_list.resize(location_files.back());
+	std::vector<boost::uint32_t> next(location_files.begin(), location_files.end() - 1);
+	for(size_t i = 0; i < info.files.size() && i < selected.size(); i++) {
+		if(selected[i] && info.files[i].location < location_count) {
+			file_list[next[info.files[i].location]++] = boost::uint32_t(i);
+		}
+	}
+	
+	// Only data entries with selected files are read
+	std::vector<boost::uint32_t> order;
+	for(size_t i = 0; i < location_count; i++) {
+		if(location_files[i] != location_files[i + 1]) {
+			order.push_back(boost::uint32_t(i));
+		}
+	}
+	
+	sort_entries(info, order);
+	
+	// Group the data entries by chunk
+	chunk_list.clear();
+	chunk_entries.clear();
+	entry_list.clear();
+	entry_list.reserve(order.size());
+	BOOST_FOREACH(boost::uint32_t index, order) {
+		
+		const setup::data_entry & data = info.data_entries[index];
+		
+		if(!entry_list.empty()) {
+			const setup::data_entry & last = info.data_entries[entry_list.back()];
+			if(data.chunk == last.chunk) {
+				if(data.file == last.file) {
+					// Same data as the previous entry - only read it once
+					entry_list.back() = index;
+				} else {
+					entry_list.push_back(index);
+				}
+				continue;
+			}
+		}
+		
+		chunk_list.push_back(data.chunk);
+		chunk_entries.push_back(boost::uint32_t(entry_list.size()));
+		entry_list.push_back(index);
+	}
+	chunk_entries.push_back(boost::uint32_t(entry_list.size()));
+}
+
+void plan::save(std::ostream & os) const {
+	
+	std::string out(plan_magic, sizeof(plan_magic));
+	store(out, plan_format);
+	
+	store(out, boost::uint32_t(chunk_list.size()));
+	BOOST_FOREACH(const stream::chunk & chunk, chunk_list) {
+		store(out, boost::uint32_t(chunk.first_slice));
+		store(out, boost::uint32_t(chunk.last_slice));
+		store(out, chunk.offset);
+		store(out, chunk.size);
+		store(out, boost::uint8_t(chunk.compression));
+		store(out, boost::uint8_t(chunk.encrypted));
+	}
+	
+	store_indices(out, chunk_entries);
+	store_indices(out, entry_list);
+	store_indices(out, location_files);
+	store_indices(out, file_list);
+	
+	os.write(out.data(), std::streamsize(out.size()));
+	if(os.fail()) {
+		throw std::ios_base::failure("could not write plan");
+	}
+}
+
+void plan::load(std::istream & is, const setup::info & info) {
+	
+	std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+	util::span_reader in(data);
+	
+	if(in.remaining() < sizeof(plan_magic)
+	   || std::memcmp(in.take(sizeof(plan_magic)), plan_magic, sizeof(plan_magic)) != 0
+	   || util::load<boost::uint32_t>(in) != plan_format) {
+		throw std::ios_base::failure("not a plan file");
+	}
+	
+	size_t chunk_count = util::load<boost::uint32_t>(in);
+	if(chunk_count > in.remaining()) {
+		throw std::ios_base::failure("truncated plan");
+	}
+	chunk_list.resize(chunk_count);
+	BOOST_FOREACH(stream::chunk & chunk, chunk_list) {
+		chunk.first_slice = util::load<boost::uint32_t>(in);
+		chunk.last_slice = util::load<boost::uint32_t>(in);
+		chunk.offset = util::load<boost::uint32_t>(in);
+		chunk.size = util::load<boost::uint64_t>(in);
+		boost::uint8_t compression = util::load<boost::uint8_t>(in);
+		if(compression > stream::UnknownCompression) {
+			throw std::ios_base::failure("invalid compression in plan");
+		}
+		chunk.compression = stream::compression_method(compression);
+		chunk.encrypted = util::load_bool(in);
+	}
+	
+	size_t location_count = info.data_entries.size();
+	size_t file_count = info.files.size();
+	
+	load_indices(in, chunk_entries);
+	load_indices(in, entry_list);
+	load_indices(in, location_files);
+	load_indices(in, file_list);
+	
+	check_ranges(chunk_entries, chunk_list.size(), entry_list.size());
+	check_ranges(location_files, location_count, file_list.size());
+	BOOST_FOREACH(boost::uint32_t index, entry_list) {
+		if(index >= location_count) {
+			throw std::ios_base::failure("invalid data entry in plan");
+		}
+	}
+	BOOST_FOREACH(boost::uint32_t index, file_list) {
+		if(index >= file_count) {
+			throw std::ios_base::failure("invalid file entry in plan");
+		}
+	}
+	
+	if(!in.eof()) {
+		throw std::ios_base::failure("unknown data at end of plan");
+	}
+}
+
+} // namespace loader
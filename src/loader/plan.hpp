@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Flat plan for reading the file data of a setup file in storage order.
+ */
+#ifndef INNOEXTRACT_LOADER_PLAN_HPP
+#define INNOEXTRACT_LOADER_PLAN_HPP
+
+#include <stddef.h>
+#include <iosfwd>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "stream/chunk.hpp"
+
+namespace setup { struct info; }
+
+namespace loader {
+
+/*!
+ * Order in which to read the data entries of a setup file.
+ *
+ * Selected data entries are sorted by their position in the setup data (slice, chunk
+ * offset and offset in the decompressed chunk) and grouped by chunk, so that every chunk
+ * only needs to be decoded once and files can be read from the chunk front to back.
+ *
+ * All data is stored in flat arrays: the data entries for a chunk and the file entries
+ * for a data entry are contiguous ranges of \ref entries() and \ref files().
+ * Plans only reference entries by index and can be saved and loaded to share them
+ * between processes that load the same setup headers.
+ */
+class plan {
+	
+public:
+	
+	plan() { }
+	
+	/*!
+	 * Build a plan for reading the data of the selected files.
+	 *
+	 * Data entries that are not referenced by any selected file are not read.
+	 * If multiple data entries refer to the same data, only the last one is read.
+	 *
+	 * \param info     The setup headers. The \ref stream::chunk::compression of the data
+	 *                 entries should already be resolved.
+	 * \param selected Which of the \ref setup::info::files to read.
+	 */
+	void build(const setup::info & info, const std::vector<bool> & selected);
+	
+	//! \return the chunks in the order they should be read.
+	const std::vector<stream::chunk> & chunks() const { return chunk_list; }
+	
+	//! \return indices into \ref setup::info::data_entries in the order they should be read.
+	const std::vector<boost::uint32_t> & entries() const { return entry_list; }
+	
+	//! \return the index of the first of the \ref entries() for the given chunk.
+	size_t entries_begin(size_t chunk) const { return chunk_entries[chunk]; }
+	
+	//! \return the index after the last of the \ref entries() for the given chunk.
+	size_t entries_end(size_t chunk) const { return chunk_entries[chunk + 1]; }
+	
+	//! \return indices into \ref setup::info::files, grouped by data entry.
+	const std::vector<boost::uint32_t> & files() const { return file_list; }
+	
+	//! \return the index of the first of the \ref files() for the given data entry.
+	size_t files_begin(size_t data_index) const { return location_files[data_index]; }
+	
+	//! \return the index after the last of the \ref files() for the given data entry.
+	size_t files_end(size_t data_index) const { return location_files[data_index + 1]; }
+	
+	/*!
+	 * Write the plan to a stream.
+	 *
+	 * \throws std::ios_base::failure if the plan could not be written.
+	 */
+	void save(std::ostream & os) const;
+	
+	/*!
+	 * Load a plan written by \ref save.
+	 *
+	 * \param is   The stream to read the plan from.
+	 * \param info The setup headers the plan was built for.
+	 *
+	 * \throws std::ios_base::failure if the plan could not be read, is corrupted or does
+	 *                                not match the setup headers.
+	 */
+	void load(std::istream & is, const setup::info & info);
+	
+private:
+	
+	std::vector<stream::chunk> chunk_list;
+	std::vector<boost::uint32_t> chunk_entries;  //!< Start of each chunk in entry_list.
+	std::vector<boost::uint32_t> entry_list;
+	std::vector<boost::uint32_t> location_files; //!< Start of each data entry in file_list.
+	std::vector<boost::uint32_t> file_list;
+	
+};
+
+} // namespace loader
+
+#endif // INNOEXTRACT_LOADER_PLAN_HPP
@@ -53,7 +53,7 @@ STORED_FLAGS_MAP(stored_component_flags_2,
 
 } // anonymous namespace
 
-void component_entry::load(std::istream & is, const version & version) {
+void component_entry::load(util::span_reader & is, const version & version) {
 	
 	is >> util::encoded_string(name, version.codepage());
 	is >> util::encoded_string(description, version.codepage());
@@ -29,11 +29,70 @@
 
 namespace setup {
 
-void data_entry::load(std::istream & is, const version & version) {
+data_entry::layout::layout(const version & version) : options(version.bits) {
+	
+	has_one_based_slices = (version < INNO_VERSION(4, 0, 0));
+	has_file_offset = (version >= INNO_VERSION(4, 0, 1));
+	has_large_sizes = (version >= INNO_VERSION(4, 0, 0));
+	is_always_compressed = (version < INNO_VERSION(4, 2, 5));
+	
+	if(version >= INNO_VERSION(5, 3, 9)) {
+		checksum = crypto::SHA1;
+	} else if(version >= INNO_VERSION(4, 2, 0)) {
+		checksum = crypto::MD5;
+	} else if(version >= INNO_VERSION(4, 0, 1)) {
+		checksum = crypto::CRC32;
+	} else {
+		checksum = crypto::Adler32;
+	}
+	
+	if(version < INNO_VERSION(5, 2, 0)) {
+		filter = stream::InstructionFilter4108;
+	} else if(version < INNO_VERSION(5, 3, 9)) {
+		filter = stream::InstructionFilter5200;
+	} else {
+		filter = stream::InstructionFilter5309;
+	}
+	
+	options.add(VersionInfoValid);
+	options.add(VersionInfoNotValid);
+	if(version >= INNO_VERSION(2, 0, 17) && version < INNO_VERSION(4, 0, 1)) {
+		options.add(BZipped);
+	}
+	if(version >= INNO_VERSION(4, 0, 10)) {
+		options.add(TimeStampInUTC);
+	}
+	if(version >= INNO_VERSION(4, 1, 0)) {
+		options.add(IsUninstallerExe);
+	}
+	if(version >= INNO_VERSION(4, 1, 8)) {
+		options.add(CallInstructionOptimized);
+	}
+	if(version >= INNO_VERSION(4, 2, 0)) {
+		options.add(Touch);
+	}
+	if(version >= INNO_VERSION(4, 2, 2)) {
+		options.add(ChunkEncrypted);
+	}
+	if(version >= INNO_VERSION(4, 2, 5)) {
+		options.add(ChunkCompressed);
+	}
+	if(version >= INNO_VERSION(5, 1, 13)) {
+		options.add(SolidBreak);
+	}
+	
+}
+
+void data_entry::load(util::span_reader & is, const version & version) {
+	load(is, version, layout(version));
+}
+
+void data_entry::load(util::span_reader & is, const version & version,
+                      const layout & format) {
 	
 	chunk.first_slice = util::load<boost::uint32_t>(is, version.bits);
 	chunk.last_slice = util::load<boost::uint32_t>(is, version.bits);
-	if(version < INNO_VERSION(4, 0, 0)) {
+	if(format.has_one_based_slices) {
 		if(chunk.first_slice < 1 || chunk.last_slice < 1) {
 			log_warning << "Unexpected slice number: " << chunk.first_slice
 			            << " to " << chunk.last_slice;
@@ -44,13 +103,13 @@ void data_entry::load(std::istream & is, const version & version) {
 	
 	chunk.offset = util::load<boost::uint32_t>(is);
 	
-	if(version >= INNO_VERSION(4, 0, 1)) {
+	if(format.has_file_offset) {
 		file.offset = util::load<boost::uint64_t>(is);
 	} else {
 		file.offset = 0;
 	}
 	
-	if(version >= INNO_VERSION(4, 0, 0)) {
+	if(format.has_large_sizes) {
 		file.size = util::load<boost::uint64_t>(is);
 		chunk.size = util::load<boost::uint64_t>(is);
 	} else {
@@ -58,18 +117,12 @@ void data_entry::load(std::istream & is, const version & version) {
 		chunk.size = util::load<boost::uint32_t>(is);
 	}
 	
-	if(version >= INNO_VERSION(5, 3, 9)) {
-		is.read(file.checksum.sha1, std::streamsize(sizeof(file.checksum.sha1)));
-		file.checksum.type = crypto::SHA1;
-	} else if(version >= INNO_VERSION(4, 2, 0)) {
-		is.read(file.checksum.md5, std::streamsize(sizeof(file.checksum.md5)));
-		file.checksum.type = crypto::MD5;
-	} else if(version >= INNO_VERSION(4, 0, 1)) {
-		file.checksum.crc32 = util::load<boost::uint32_t>(is);
-		file.checksum.type = crypto::CRC32;
-	} else {
-		file.checksum.adler32 = util::load<boost::uint32_t>(is);
-		file.checksum.type = crypto::Adler32;
+	file.checksum.type = format.checksum;
+	switch(format.checksum) {
+		case crypto::SHA1: is.read(file.checksum.sha1, sizeof(file.checksum.sha1)); break;
+		case crypto::MD5: is.read(file.checksum.md5, sizeof(file.checksum.md5)); break;
+		case crypto::CRC32: file.checksum.crc32 = util::load<boost::uint32_t>(is); break;
+		case crypto::Adler32: file.checksum.adler32 = util::load<boost::uint32_t>(is); break;
 	}
 	
 	if(version.bits == 16) {
@@ -112,40 +165,10 @@ void data_entry::load(std::istream & is, const version & version) {
 	file_version = (boost::uint64_t(file_version_ms) << 32)
 	             |  boost::uint64_t(file_version_ls);
 	
-	options = 0;
-	
-	stored_flag_reader<flags> flagreader(is, version.bits);
-	
-	flagreader.add(VersionInfoValid);
-	flagreader.add(VersionInfoNotValid);
-	if(version >= INNO_VERSION(2, 0, 17) && version < INNO_VERSION(4, 0, 1)) {
-		flagreader.add(BZipped);
-	}
-	if(version >= INNO_VERSION(4, 0, 10)) {
-		flagreader.add(TimeStampInUTC);
-	}
-	if(version >= INNO_VERSION(4, 1, 0)) {
-		flagreader.add(IsUninstallerExe);
-	}
-	if(version >= INNO_VERSION(4, 1, 8)) {
-		flagreader.add(CallInstructionOptimized);
-	}
-	if(version >= INNO_VERSION(4, 2, 0)) {
-		flagreader.add(Touch);
-	}
-	if(version >= INNO_VERSION(4, 2, 2)) {
-		flagreader.add(ChunkEncrypted);
-	}
-	if(version >= INNO_VERSION(4, 2, 5)) {
-		flagreader.add(ChunkCompressed);
-	} else {
+	options = format.options.load(is);
+	if(format.is_always_compressed) {
 		options |= ChunkCompressed;
 	}
-	if(version >= INNO_VERSION(5, 1, 13)) {
-		flagreader.add(SolidBreak);
-	}
-	
-	options |= flagreader;
 	
 	if(options & ChunkCompressed) {
 		chunk.compression = stream::UnknownCompression;
@@ -160,13 +183,7 @@ void data_entry::load(std::istream & is, const version & version) {
 	chunk.encrypted = ((options & ChunkEncrypted) != 0);
 	
 	if(options & CallInstructionOptimized) {
-		if(version < INNO_VERSION(5, 2, 0)) {
-			file.filter = stream::InstructionFilter4108;
-		} else if(version < INNO_VERSION(5, 3, 9)) {
-			file.filter = stream::InstructionFilter5200;
-		} else {
-			file.filter = stream::InstructionFilter5309;
-		}
+		file.filter = format.filter;
 	} else {
 		file.filter = stream::NoFilter;
 	}
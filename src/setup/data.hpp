@@ -27,7 +27,6 @@
 #define INNOEXTRACT_SETUP_DATA_HPP
 
 #include <stddef.h>
-#include <iosfwd>
 
 #include <boost/cstdint.hpp>
 
@@ -36,6 +35,7 @@
 #include "stream/file.hpp"
 #include "util/enum.hpp"
 #include "util/flags.hpp"
+#include "util/storedenum.hpp"
 
 namespace setup {
 
@@ -75,7 +75,37 @@ struct data_entry {
 	 *
 	 * \note This function may not be thread-safe on all operating systems.
 	 */
-	void load(std::istream & is, const version & version);
+	void load(util::span_reader & is, const version & version);
+	
+	/*!
+	 * Version-dependent parts of the stored data entry format.
+	 *
+	 * These are the same for all entries in an installer and only need to be
+	 * determined once.
+	 */
+	struct layout {
+		
+		explicit layout(const version & version);
+		
+		bool has_one_based_slices;
+		bool has_file_offset;
+		bool has_large_sizes;
+		bool is_always_compressed; //!< There is no \c ChunkCompressed flag
+		
+		crypto::checksum_type checksum;
+		
+		stream::compression_filter filter; //!< Filter for \c CallInstructionOptimized
+		
+		stored_flag_map<flags> options;
+		
+	};
+	
+	/*!
+	 * Load one data entry using a precomputed \ref layout for the given version.
+	 *
+	 * \note This function may not be thread-safe on all operating systems.
+	 */
+	void load(util::span_reader & is, const version & version, const layout & format);
 	
 };
 
@@ -27,11 +27,12 @@
 #define INNOEXTRACT_SETUP_DELETE_HPP
 
 #include <string>
-#include <iosfwd>
 
 #include "setup/item.hpp"
 #include "util/enum.hpp"
 
+namespace util { class span_reader; }
+
 namespace setup {
 
 struct version;
@@ -48,7 +49,7 @@ struct delete_entry : public item {
 	
 	target_type type;
 	
-	void load(std::istream & is, const version & version);
+	void load(util::span_reader & is, const version & version);
 	
 };
 
@@ -21,10 +21,13 @@
 #include "setup/expression.hpp"
 
 #include <stddef.h>
+#include <algorithm>
 #include <cstring>
 #include <vector>
 #include <stdexcept>
 
+#include <boost/foreach.hpp>
+
 #include "util/log.hpp"
 
 namespace setup {
@@ -39,9 +42,12 @@ static bool is_identifier(char c) {
 	return is_identifier_start(c) || (c >= '0' && c <= '9') || c == '\\';
 }
 
-struct evaluator {
+} // anonymous namespace
+
+//! Recursive descent parser that emits postfix instructions.
+class expression_parser {
 	
-	const std::string & test;
+	expression & target;
 	const char * expr;
 	
 	enum token_type {
@@ -53,10 +59,25 @@ struct evaluator {
 		paren_right,
 		identifier
 	} token;
-	std::string token_str;
+	const char * token_start;
+	
+	size_t depth;
+	
+public:
+	
+	expression_parser(expression & target, const std::string & expr)
+		: target(target), expr(expr.c_str()), token(end), token_start(NULL), depth(0) { }
 	
-	evaluator(const std::string & expr, const std::string & test)
-		: test(test), expr(expr.c_str()), token(end) { }
+	void parse() {
+		target.max_depth = 0;
+		next();
+		parse_expression();
+		if(token != end) {
+			throw std::runtime_error("unexpected token");
+		}
+	}
+	
+private:
 	
 	token_type next() {
 		
@@ -76,87 +97,164 @@ struct evaluator {
 			
 		} else if(is_identifier_start(*expr)) {
 			
-			const char * start = expr++;
+			token_start = expr++;
 			while(is_identifier(*expr)) {
 				expr++;
 			}
 			
-			if(expr - start == 3 && !memcmp(start, "not", 3)) {
+			if(expr - token_start == 3 && !memcmp(token_start, "not", 3)) {
 				return (token = op_not);
-			} else if(expr - start == 3 && !memcmp(start, "and", 3)) {
+			} else if(expr - token_start == 3 && !memcmp(token_start, "and", 3)) {
 				return (token = op_and);
-			} else if(expr - start == 2 && !memcmp(start, "or", 2)) {
+			} else if(expr - token_start == 2 && !memcmp(token_start, "or", 2)) {
 				return (token = op_or);
 			}
 			
-			return (token_str.assign(start, expr), token = identifier);
+			return (token = identifier);
 			
 		} else {
 			throw std::runtime_error(std::string("unexpected symbol: ") + *expr);
 		}
 	}
 	
-	bool eval_identifier(bool lazy) {
-		bool result = lazy || token_str == test;
+	void emit(expression::opcode op, size_t identifier = 0) {
+		expression::instruction instruction = { op, identifier };
+		target.code.push_back(instruction);
+		if(op == expression::Push) {
+			target.max_depth = std::max(target.max_depth, ++depth);
+		} else if(op != expression::Not) {
+			depth--;
+		}
+	}
+	
+	void parse_identifier() {
+		
+		std::string name(token_start, expr);
+		
+		std::vector<std::string>::const_iterator i;
+		i = std::find(target.names.begin(), target.names.end(), name);
+		if(i == target.names.end()) {
+			target.names.push_back(name);
+			i = target.names.end() - 1;
+		}
+		
+		emit(expression::Push, size_t(i - target.names.begin()));
 		next();
-		return result;
 	}
 	
-	bool eval_factor(bool lazy) {
+	void parse_factor() {
 		if(token == paren_left) {
 			next();
-			bool result = eval_expression(lazy);
+			parse_expression();
 			if(token != paren_right) {
 				throw std::runtime_error("expected closing parenthesis");
 			}
 			next();
-			return result;
 		} else if(token == op_not) {
 			next();
-			return !eval_factor(lazy);
+			parse_factor();
+			emit(expression::Not);
 		} else if(token == identifier) {
-			return eval_identifier(lazy);
+			parse_identifier();
 		} else {
 			throw std::runtime_error("unexpected token");
 		}
 	}
 	
-	bool eval_term(bool lazy) {
-		bool result = eval_factor(lazy);
+	void parse_term() {
+		parse_factor();
 		while(token == op_and) {
 			next();
-			result = result && eval_factor(lazy || !result);
+			parse_factor();
+			emit(expression::And);
 		}
-		return result;
 	}
 	
-	bool eval_expression(bool lazy) {
-		bool result = eval_term(lazy);
+	void parse_expression() {
+		parse_term();
+		// Identifiers separated only by whitespace are implicitly or-ed
 		while(token == op_or || token == identifier) {
 			if(token == op_or) {
 				next();
 			}
-			result = result || eval_term(lazy || result);
+			parse_term();
+			emit(expression::Or);
 		}
-		return result;
 	}
 	
-	bool eval() {
-		next();
-		return eval_expression(false);
+};
+
+expression::expression(const std::string & expr) {
+	expression_parser(*this, expr).parse();
+}
+
+bool expression::evaluate(const std::vector<bool> & values) const {
+	
+	std::vector<char> stack;
+	stack.reserve(max_depth);
+	
+	BOOST_FOREACH(const instruction & i, code) {
+		switch(i.op) {
+			case Push: stack.push_back(values[i.identifier]); break;
+			case Not: stack.back() = !stack.back(); break;
+			case And: {
+				char value = stack.back();
+				stack.pop_back();
+				stack.back() = stack.back() && value;
+				break;
+			}
+			case Or: {
+				char value = stack.back();
+				stack.pop_back();
+				stack.back() = stack.back() || value;
+				break;
+			}
+		}
 	}
 	
-};
+	return stack.back() != 0;
+}
 
-} // anonymous namespace
+void expression_matcher::add(const std::string & identifier) {
+	identifiers.insert(identifier);
+	cache.clear();
+}
 
-bool expression_match(const std::string & test, const std::string & expr) {
+bool expression_matcher::evaluate(const std::string & expr) const {
+	
 	try {
-		return evaluator(expr, test).eval();
+		
+		expression compiled(expr);
+		
+		std::vector<bool> values;
+		values.reserve(compiled.identifiers().size());
+		BOOST_FOREACH(const std::string & name, compiled.identifiers()) {
+			values.push_back(identifiers.find(name) != identifiers.end());
+		}
+		
+		return compiled.evaluate(values);
+		
 	} catch(const std::runtime_error & error) {
 		log_warning << "Error evaluating \"" << expr << "\": " << error.what();
 		return true;
 	}
 }
 
+bool expression_matcher::match(const std::string & expr) const {
+	
+	boost::unordered_map<std::string, bool>::const_iterator i = cache.find(expr);
+	if(i != cache.end()) {
+		return i->second;
+	}
+	
+	bool result = evaluate(expr);
+	cache[expr] = result;
+	
+	return result;
+}
+
+bool expression_match(const std::string & test, const std::string & expr) {
+	return expression_matcher(test).match(expr);
+}
+
 } // namespace setup
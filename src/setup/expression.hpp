@@ -26,10 +26,99 @@
 #ifndef INNOEXTRACT_SETUP_EXPRESSION_HPP
 #define INNOEXTRACT_SETUP_EXPRESSION_HPP
 
+#include <stddef.h>
 #include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 
 namespace setup {
 
+/*!
+ * Boolean expression over identifiers, as used for the languages, components and tasks
+ * of setup entries.
+ *
+ * Expressions are compiled once into a list of instructions for a small stack machine.
+ */
+class expression {
+	
+public:
+	
+	/*!
+	 * Compile an expression.
+	 *
+	 * \throws std::runtime_error if the expression is not valid.
+	 */
+	explicit expression(const std::string & expr);
+	
+	//! \return the distinct identifiers used in the expression.
+	const std::vector<std::string> & identifiers() const { return names; }
+	
+	/*!
+	 * Evaluate the expression.
+	 *
+	 * \param values The value of each identifier returned by \ref identifiers().
+	 */
+	bool evaluate(const std::vector<bool> & values) const;
+	
+private:
+	
+	enum opcode {
+		Push,
+		Not,
+		And,
+		Or
+	};
+	
+	struct instruction {
+		opcode op;
+		size_t identifier; //!< Index into \ref names for \ref Push instructions.
+	};
+	
+	std::vector<std::string> names;
+	std::vector<instruction> code;
+	size_t max_depth;
+	
+	friend class expression_parser;
+	
+};
+
+/*!
+ * Evaluate expressions for a fixed set of identifiers that are true.
+ *
+ * Results are cached per distinct expression string, so that evaluating the conditions
+ * of all entries only compiles each distinct expression once.
+ */
+class expression_matcher {
+	
+public:
+	
+	expression_matcher() { }
+	
+	//! Create a matcher where only the given identifier is true.
+	explicit expression_matcher(const std::string & identifier) { add(identifier); }
+	
+	//! Set the given identifier to true.
+	void add(const std::string & identifier);
+	
+	/*!
+	 * \return the value of the expression. Invalid expressions are reported once
+	 *         and evaluate to true.
+	 */
+	bool match(const std::string & expr) const;
+	
+private:
+	
+	bool evaluate(const std::string & expr) const;
+	
+	boost::unordered_set<std::string> identifiers;
+	
+	mutable boost::unordered_map<std::string, bool> cache;
+	
+};
+
+//! Evaluate an expression where only \c test is true.
 bool expression_match(const std::string & test, const std::string & expression);
 
 } // namespace setup
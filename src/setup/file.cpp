@@ -70,126 +70,140 @@ NAMES(setup::file_copy_mode, "File Copy Mode",
 
 namespace setup {
 
-void file_entry::load(std::istream & is, const version & version) {
+file_entry::layout::layout(const version & version) : options(version.bits) {
 	
-	USE_ENUM_NAMES(file_copy_mode)
-	
-	options = 0;
-	
-	if(version < INNO_VERSION(1, 3, 21)) {
-		(void)util::load<boost::uint32_t>(is); // uncompressed size of the entry
-	}
-	
-	is >> util::encoded_string(source, version.codepage());
-	is >> util::encoded_string(destination, version.codepage());
-	is >> util::encoded_string(install_font_name, version.codepage());
-	if(version >= INNO_VERSION(5, 2, 5)) {
-		is >> util::encoded_string(strong_assembly_name, version.codepage());
-	} else {
-		strong_assembly_name.clear();
-	}
-	
-	load_condition_data(is, version);
-	
-	load_version_data(is, version);
-	
-	location = util::load<boost::uint32_t>(is, version.bits);
-	attributes = util::load<boost::uint32_t>(is, version.bits);
-	external_size = (version >= INNO_VERSION(4, 0, 0)) ? util::load<boost::uint64_t>(is)
-	                                                   : util::load<boost::uint32_t>(is);
-	
-	if(version < INNO_VERSION(3, 0, 5)) {
-		file_copy_mode copyMode = stored_enum<stored_file_copy_mode>(is).get();
-		switch(copyMode) {
-			case cmNormal: options |= PromptIfOlder; break;
-			case cmIfDoesntExist: options |= OnlyIfDoesntExist | PromptIfOlder; break;
-			case cmAlwaysOverwrite: options |= IgnoreVersion | PromptIfOlder; break;
-			case cmAlwaysSkipIfSameOrOlder: break;
-		}
-	}
-	
-	if(version >= INNO_VERSION(4, 1, 0)) {
-		permission = util::load<boost::int16_t>(is);
-	} else {
-		permission = boost::int16_t(-1);
-	}
-	
-	stored_flag_reader<flags> flagreader(is, version.bits);
+	has_uncompressed_size = (version < INNO_VERSION(1, 3, 21));
+	has_strong_assembly_name = (version >= INNO_VERSION(5, 2, 5));
+	has_large_external_size = (version >= INNO_VERSION(4, 0, 0));
+	has_copy_mode = (version < INNO_VERSION(3, 0, 5));
+	has_permission = (version >= INNO_VERSION(4, 1, 0));
+	has_extended_type = (version.bits != 16 && version < INNO_VERSION(5, 0, 0));
 	
-	flagreader.add(ConfirmOverwrite);
-	flagreader.add(NeverUninstall);
-	flagreader.add(RestartReplace);
-	flagreader.add(DeleteAfterInstall);
+	options.add(ConfirmOverwrite);
+	options.add(NeverUninstall);
+	options.add(RestartReplace);
+	options.add(DeleteAfterInstall);
 	if(version.bits != 16) {
-		flagreader.add(RegisterServer);
-		flagreader.add(RegisterTypeLib);
-		flagreader.add(SharedFile);
+		options.add(RegisterServer);
+		options.add(RegisterTypeLib);
+		options.add(SharedFile);
 	}
 	if(version < INNO_VERSION(2, 0, 0)) {
-		flagreader.add(IsReadmeFile);
+		options.add(IsReadmeFile);
 	}
-	flagreader.add(CompareTimeStamp);
-	flagreader.add(FontIsNotTrueType);
-	flagreader.add(SkipIfSourceDoesntExist);
-	flagreader.add(OverwriteReadOnly);
+	options.add(CompareTimeStamp);
+	options.add(FontIsNotTrueType);
+	options.add(SkipIfSourceDoesntExist);
+	options.add(OverwriteReadOnly);
 	if(version >= INNO_VERSION(1, 3, 21)) {
-		flagreader.add(OverwriteSameVersion);
-		flagreader.add(CustomDestName);
+		options.add(OverwriteSameVersion);
+		options.add(CustomDestName);
 	}
 	if(version >= INNO_VERSION(1, 3, 25)) {
-		flagreader.add(OnlyIfDestFileExists);
+		options.add(OnlyIfDestFileExists);
 	}
 	if(version >= INNO_VERSION(2, 0, 5)) {
-		flagreader.add(NoRegError);
+		options.add(NoRegError);
 	}
 	if(version >= INNO_VERSION(3, 0, 1)) {
-		flagreader.add(UninsRestartDelete);
+		options.add(UninsRestartDelete);
 	}
 	if(version >= INNO_VERSION(3, 0, 5)) {
-		flagreader.add(OnlyIfDoesntExist);
-		flagreader.add(IgnoreVersion);
-		flagreader.add(PromptIfOlder);
+		options.add(OnlyIfDoesntExist);
+		options.add(IgnoreVersion);
+		options.add(PromptIfOlder);
 	}
 	if(version >= INNO_VERSION_EXT(3, 0, 6, 1)) {
-		flagreader.add(DontCopy);
+		options.add(DontCopy);
 	}
 	if(version >= INNO_VERSION(4, 0, 5)) {
-		flagreader.add(UninsRemoveReadOnly);
+		options.add(UninsRemoveReadOnly);
 	}
 	if(version >= INNO_VERSION(4, 1, 8)) {
-		flagreader.add(RecurseSubDirsExternal);
+		options.add(RecurseSubDirsExternal);
 	}
 	if(version >= INNO_VERSION(4, 2, 1)) {
-		flagreader.add(ReplaceSameVersionIfContentsDiffer);
+		options.add(ReplaceSameVersionIfContentsDiffer);
 	}
 	if(version >= INNO_VERSION(4, 2, 5)) {
-		flagreader.add(DontVerifyChecksum);
+		options.add(DontVerifyChecksum);
 	}
 	if(version >= INNO_VERSION(5, 0, 3)) {
-		flagreader.add(UninsNoSharedFilePrompt);
+		options.add(UninsNoSharedFilePrompt);
 	}
 	if(version >= INNO_VERSION(5, 1, 0)) {
-		flagreader.add(CreateAllSubDirs);
+		options.add(CreateAllSubDirs);
 	}
 	if(version >= INNO_VERSION(5, 1, 2)) {
-		flagreader.add(Bits32);
-		flagreader.add(Bits64);
+		options.add(Bits32);
+		options.add(Bits64);
 	}
 	if(version >= INNO_VERSION(5, 2, 0)) {
-		flagreader.add(ExternalSizePreset);
-		flagreader.add(SetNtfsCompression);
-		flagreader.add(UnsetNtfsCompression);
+		options.add(ExternalSizePreset);
+		options.add(SetNtfsCompression);
+		options.add(UnsetNtfsCompression);
 	}
 	if(version >= INNO_VERSION(5, 2, 5)) {
-		flagreader.add(GacInstall);
+		options.add(GacInstall);
+	}
+	
+}
+
+void file_entry::load(util::span_reader & is, const version & version) {
+	load(is, version, layout(version));
+}
+
+void file_entry::load(util::span_reader & is, const version & version,
+                      const layout & format) {
+	
+	USE_ENUM_NAMES(file_copy_mode)
+	
+	options = 0;
+	
+	if(format.has_uncompressed_size) {
+		(void)util::load<boost::uint32_t>(is); // uncompressed size of the entry
+	}
+	
+	is >> util::encoded_string(source, version.codepage());
+	is >> util::encoded_string(destination, version.codepage());
+	is >> util::encoded_string(install_font_name, version.codepage());
+	if(format.has_strong_assembly_name) {
+		is >> util::encoded_string(strong_assembly_name, version.codepage());
+	} else {
+		strong_assembly_name.clear();
 	}
 	
-	options |= flagreader;
+	load_condition_data(is, version);
 	
-	if(version.bits == 16 || version >= INNO_VERSION(5, 0, 0)) {
-		type = stored_enum<stored_file_type_0>(is).get();
+	load_version_data(is, version);
+	
+	location = util::load<boost::uint32_t>(is, version.bits);
+	attributes = util::load<boost::uint32_t>(is, version.bits);
+	external_size = format.has_large_external_size ? util::load<boost::uint64_t>(is)
+	                                               : util::load<boost::uint32_t>(is);
+	
+	if(format.has_copy_mode) {
+		file_copy_mode copyMode = stored_enum<stored_file_copy_mode>(is).get();
+		switch(copyMode) {
+			case cmNormal: options |= PromptIfOlder; break;
+			case cmIfDoesntExist: options |= OnlyIfDoesntExist | PromptIfOlder; break;
+			case cmAlwaysOverwrite: options |= IgnoreVersion | PromptIfOlder; break;
+			case cmAlwaysSkipIfSameOrOlder: break;
+		}
+	}
+	
+	if(format.has_permission) {
+		permission = util::load<boost::int16_t>(is);
 	} else {
+		permission = boost::int16_t(-1);
+	}
+	
+	options |= format.options.load(is);
+	
+	if(format.has_extended_type) {
 		type = stored_enum<stored_file_type_1>(is).get();
+	} else {
+		type = stored_enum<stored_file_type_0>(is).get();
 	}
 }
 
@@ -27,13 +27,13 @@
 #define INNOEXTRACT_SETUP_FILE_HPP
 
 #include <string>
-#include <iosfwd>
 
 #include <boost/cstdint.hpp>
 
 #include "setup/item.hpp"
 #include "util/enum.hpp"
 #include "util/flags.hpp"
+#include "util/storedenum.hpp"
 
 namespace setup {
 
@@ -101,7 +101,31 @@ struct file_entry : public item {
 	
 	file_type type;
 	
-	void load(std::istream & is, const version & version);
+	/*!
+	 * Version-dependent parts of the stored file entry format.
+	 *
+	 * These are the same for all entries in an installer and only need to be
+	 * determined once.
+	 */
+	struct layout {
+		
+		explicit layout(const version & version);
+		
+		bool has_uncompressed_size;
+		bool has_strong_assembly_name;
+		bool has_large_external_size;
+		bool has_copy_mode;
+		bool has_permission;
+		bool has_extended_type;
+		
+		stored_flag_map<flags> options;
+		
+	};
+	
+	void load(util::span_reader & is, const version & version);
+	
+	//! Load one file entry using a precomputed \ref layout for the given version.
+	void load(util::span_reader & is, const version & version, const layout & format);
 	
 };
 
@@ -23,6 +23,9 @@
 #include <stddef.h>
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+
+#include <boost/functional/hash.hpp>
 
 namespace setup {
 
@@ -35,10 +38,73 @@ struct is_path_separator {
 	}
 };
 
+//! Prefix of a string used to look up cache entries without copying it.
+struct prefix_ref {
+	const std::string & str;
+	size_t length;
+	prefix_ref(const std::string & str, size_t length) : str(str), length(length) { }
+};
+
+//! Must produce the same hashes as boost::hash<std::string>.
+struct prefix_hash {
+	size_t operator()(const prefix_ref & ref) const {
+		return boost::hash_range(ref.str.begin(), ref.str.begin() + std::ptrdiff_t(ref.length));
+	}
+};
+
+struct prefix_equal {
+	bool operator()(const prefix_ref & ref, const std::string & str) const {
+		return ref.length == str.size() && !std::memcmp(ref.str.data(), str.data(), ref.length);
+	}
+};
+
+/*!
+ * Find the last path separator that is not part of a variable name.
+ *
+ * \return the position of the separator or \c std::string::npos if there is none.
+ */
+size_t find_directory_end(const std::string & path) {
+	
+	size_t result = std::string::npos;
+	
+	size_t depth = 0;
+	for(size_t i = 0; i < path.size(); i++) {
+		char c = path[i];
+		if(c == '{') {
+			if(i + 1 < path.size() && path[i + 1] == '{') {
+				i++; // '{{' escape sequence
+			} else {
+				depth++;
+			}
+		} else if(c == '}') {
+			if(depth != 0) {
+				depth--;
+			}
+		} else if(depth == 0 && is_path_separator()(c)) {
+			result = i;
+		}
+	}
+	
+	return result;
+}
+
+//! \return true if the string is a path segment that is not modified by shorten_path().
+bool is_simple_segment(const std::string & path, size_t begin) {
+	
+	size_t length = path.size() - begin;
+	if(length == 0 || (length == 1 && path[begin] == '.')
+	   || (length == 2 && path[begin] == '.' && path[begin + 1] == '.')) {
+		return false;
+	}
+	
+	return std::find_if(path.begin() + std::ptrdiff_t(begin), path.end(),
+	                    is_path_separator()) == path.end();
+}
+
 } // anonymous namespace
 
 const std::string & filename_map::lookup(const std::string & key) const {
-	std::map<std::string, std::string>::const_iterator i = find(key);
+	const_iterator i = find(key);
 	return (i == end()) ? key : i->second;
 }
 
@@ -135,6 +201,22 @@ std::string filename_map::shorten_path(const std::string & path) const {
 	return result;
 }
 
+const std::string & filename_map::convert_directory(const std::string & path,
+                                                   size_t length) const {
+	
+	prefix_ref key(path, length);
+	cache_type::const_iterator i = directories.find(key, prefix_hash(), prefix_equal());
+	if(i != directories.end()) {
+		return i->second;
+	}
+	
+	std::string directory = path.substr(0, length);
+	it begin = directory.begin();
+	std::string converted = shorten_path(expand_variables(begin, directory.end()));
+	
+	return directories.insert(cache_type::value_type(directory, converted)).first->second;
+}
+
 std::string filename_map::convert(std::string input) const {
 	
 	// Convert paths to lower-case if requested
@@ -147,6 +229,40 @@ std::string filename_map::convert(std::string input) const {
 		return input;
 	}
 	
+	/*
+	 * Variables can't span path separators outside of braces, so the directory
+	 * and the filename can be converted independently.
+	 */
+	size_t directory_end = find_directory_end(input);
+	if(directory_end != std::string::npos) {
+		
+		const std::string & directory = convert_directory(input, directory_end);
+		
+		std::string filename;
+		size_t filename_begin = directory_end + 1;
+		if(input.find_first_of("{}", filename_begin) != std::string::npos) {
+			it begin = input.begin() + std::ptrdiff_t(filename_begin);
+			filename = expand_variables(begin, input.end());
+			filename_begin = 0;
+		} else {
+			filename.swap(input);
+		}
+		
+		if(!is_simple_segment(filename, filename_begin)) {
+			return shorten_path(directory + path_sep + filename.substr(filename_begin));
+		}
+		
+		std::string result;
+		result.reserve(directory.size() + 1 + filename.size() - filename_begin);
+		result.append(directory);
+		if(!result.empty()) {
+			result.push_back(path_sep);
+		}
+		result.append(filename, filename_begin, std::string::npos);
+		
+		return result;
+	}
+	
 	it begin = input.begin();
 	std::string expanded = expand_variables(begin, input.end());
 	
@@ -27,7 +27,8 @@
 #define INNOEXTRACT_SETUP_FILENAME_HPP
 
 #include <string>
-#include <map>
+
+#include <boost/unordered_map.hpp>
 
 namespace setup {
 
@@ -41,18 +42,25 @@ static const char path_sep = '/';
 /*!
  * Map to convert between raw windows file paths stored in the setup file (which can
  * contain variables) and output filenames.
+ *
+ * Converted directory names are cached as most files share only a few directories.
+ * The cache is not thread-safe.
  */
-class filename_map : public std::map<std::string, std::string> {
+class filename_map : public boost::unordered_map<std::string, std::string> {
 	
 	const std::string & lookup(const std::string & key) const;
 	
 	bool lowercase;
 	bool expand;
 	
+	typedef boost::unordered_map<std::string, std::string> cache_type;
+	mutable cache_type directories; //!< Converted paths for raw directory names.
+	
 	typedef std::string::const_iterator it;
 	
 	std::string expand_variables(it & begin, it end, bool close = false) const;
 	std::string shorten_path(const std::string & path) const;
+	const std::string & convert_directory(const std::string & path, size_t length) const;
 	
 public:
 	
@@ -61,10 +69,13 @@ public:
 	std::string convert(std::string path) const;
 	
 	//! Set if paths should be converted to lower-case.
-	void set_lowercase(bool enable) { lowercase = enable; }
+	void set_lowercase(bool enable) { lowercase = enable; clear_cache(); }
 	
 	//! Set if variables should be expanded and path separators converted.
-	void set_expand(bool enable) { expand = enable; }
+	void set_expand(bool enable) { expand = enable; clear_cache(); }
+	
+	//! Forget cached conversions. Must be called after modifying the variable mapping.
+	void clear_cache() { directories.clear(); }
 	
 };
 
@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "setup/filter.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+
+#include "setup/filename.hpp"
+
+namespace setup {
+
+namespace {
+
+//! Path component that has not been copied out of the path string.
+struct component_ref {
+	const char * data;
+	size_t size;
+};
+
+//! Must produce the same hashes as \ref path_filter::component_hash.
+struct component_ref_hash {
+	size_t operator()(const component_ref & ref) const {
+		return boost::hash_range(ref.data, ref.data + ref.size);
+	}
+};
+
+struct component_ref_equal {
+	bool operator()(const component_ref & ref, const std::string & str) const {
+		return ref.size == str.size() && !std::memcmp(ref.data, str.data(), ref.size);
+	}
+};
+
+bool is_glob(const std::string & component) {
+	return component.find_first_of("*?[") != std::string::npos;
+}
+
+//! Match a character against a bracket expression starting after the opening '['.
+bool match_class(const char * & pattern, const char * pattern_end, char c) {
+	
+	const char * p = pattern;
+	
+	bool negate = false;
+	if(p != pattern_end && (*p == '!' || *p == '^')) {
+		negate = true, p++;
+	}
+	
+	bool matched = false;
+	bool first = true;
+	while(p != pattern_end && (first || *p != ']')) {
+		first = false;
+		char low = *p++;
+		char high = low;
+		if(p + 1 < pattern_end && *p == '-' && p[1] != ']') {
+			high = p[1];
+			p += 2;
+		}
+		if(c >= low && c <= high) {
+			matched = true;
+		}
+	}
+	
+	if(p == pattern_end) {
+		return false; // Unterminated bracket expression
+	}
+	
+	pattern = p + 1;
+	return matched != negate;
+}
+
+//! Shell-style wildcard match of a single path component.
+bool wildcard_match(const char * pattern, const char * pattern_end,
+                    const char * str, const char * str_end) {
+	
+	const char * star = NULL;
+	const char * star_str = NULL;
+	
+	while(str != str_end) {
+		
+		if(pattern != pattern_end) {
+			
+			const char * p = pattern;
+			bool matched = false;
+			
+			switch(*p) {
+				case '*': {
+					star = ++pattern, star_str = str;
+					continue;
+				}
+				case '?': matched = true, p++; break;
+				case '[': p++, matched = match_class(p, pattern_end, *str); break;
+				default: matched = (*p++ == *str);
+			}
+			
+			if(matched) {
+				pattern = p, str++;
+				continue;
+			}
+			
+		}
+		
+		if(!star) {
+			return false;
+		}
+		
+		// Let the last star consume one more character
+		pattern = star, str = ++star_str;
+	}
+	
+	while(pattern != pattern_end && *pattern == '*') {
+		pattern++;
+	}
+	
+	return pattern == pattern_end;
+}
+
+bool component_match(const std::string & pattern, const std::string & path,
+                     size_t begin, size_t end) {
+	
+	if(!path.compare(begin, end - begin, pattern)) {
+		return true;
+	}
+	
+	const char * p = pattern.c_str();
+	const char * s = path.c_str();
+	return wildcard_match(p, p + pattern.size(), s + begin, s + end);
+}
+
+} // anonymous namespace
+
+size_t path_filter::component_hash::operator()(const std::string & component) const {
+	return boost::hash_range(component.begin(), component.end());
+}
+
+void path_filter::automaton::insert(const std::vector<component_id> & components) {
+	
+	size_t state = 0;
+	
+	BOOST_FOREACH(component_id component, components) {
+		edge e(state, component);
+		boost::unordered_map<edge, size_t>::const_iterator i = edges.find(e);
+		if(i != edges.end()) {
+			state = i->second;
+		} else {
+			size_t next = accept.size();
+			edges[e] = next;
+			accept.push_back(false);
+			fail.push_back(0);
+			state = next;
+		}
+	}
+	
+	accept[state] = true;
+}
+
+size_t path_filter::automaton::next(size_t state, component_id component) const {
+	boost::unordered_map<edge, size_t>::const_iterator i = edges.find(edge(state, component));
+	return (i == edges.end()) ? 0 : i->second;
+}
+
+void path_filter::automaton::link() {
+	
+	// Collect the children of each state
+	std::vector< std::vector<edge> > children(accept.size());
+	typedef boost::unordered_map<edge, size_t>::value_type edge_entry;
+	BOOST_FOREACH(const edge_entry & e, edges) {
+		children[e.first.first].push_back(edge(e.second, e.first.second));
+	}
+	
+	// Breadth-first traversal so that failure links always point to processed states
+	std::vector<size_t> queue;
+	queue.reserve(accept.size());
+	BOOST_FOREACH(const edge & child, children[0]) {
+		fail[child.first] = 0;
+		queue.push_back(child.first);
+	}
+	
+	for(size_t i = 0; i < queue.size(); i++) {
+		size_t state = queue[i];
+		BOOST_FOREACH(const edge & child, children[state]) {
+			size_t f = fail[state];
+			size_t target = next(f, child.second);
+			while(f != 0 && target == 0) {
+				f = fail[f];
+				target = next(f, child.second);
+			}
+			fail[child.first] = target;
+			if(accept[target]) {
+				accept[child.first] = true;
+			}
+			queue.push_back(child.first);
+		}
+	}
+	
+}
+
+void path_filter::add(const std::string & pattern) {
+	patterns.push_back(pattern);
+	compiled = false;
+}
+
+void path_filter::compile() {
+	
+	if(compiled) {
+		return;
+	}
+	
+	components.clear();
+	prefixes = automaton();
+	substrings = automaton();
+	globs.clear();
+	
+	BOOST_FOREACH(const std::string & pattern, patterns) {
+		
+		bool anchored = (!pattern.empty() && pattern[0] == path_sep);
+		
+		// Split the pattern into components
+		std::vector<std::string> parts;
+		size_t pos = anchored ? 1 : 0;
+		while(true) {
+			size_t end = pattern.find(path_sep, pos);
+			if(end == std::string::npos) {
+				parts.push_back(pattern.substr(pos));
+				break;
+			}
+			parts.push_back(pattern.substr(pos, end - pos));
+			pos = end + 1;
+		}
+		
+		bool has_glob = false;
+		BOOST_FOREACH(const std::string & part, parts) {
+			has_glob = has_glob || is_glob(part);
+		}
+		if(has_glob) {
+			glob g;
+			g.anchored = anchored;
+			g.components.swap(parts);
+			globs.push_back(g);
+			continue;
+		}
+		
+		std::vector<component_id> ids;
+		ids.reserve(parts.size());
+		BOOST_FOREACH(const std::string & part, parts) {
+			component_map::const_iterator i = components.find(part);
+			if(i == components.end()) {
+				component_id id = component_id(components.size() + 1);
+				components[part] = id;
+				ids.push_back(id);
+			} else {
+				ids.push_back(i->second);
+			}
+		}
+		
+		(anchored ? prefixes : substrings).insert(ids);
+	}
+	
+	substrings.link();
+	
+	compiled = true;
+}
+
+path_filter::component_id path_filter::lookup(const std::string & path,
+                                               size_t begin, size_t end) const {
+	
+	component_ref ref = { path.data() + begin, end - begin };
+	
+	component_map::const_iterator i;
+	i = components.find(ref, component_ref_hash(), component_ref_equal());
+	
+	return (i == components.end()) ? 0 : i->second;
+}
+
+bool path_filter::match(const std::string & path) const {
+	
+	if(!compiled) {
+		throw std::logic_error("path filter not compiled");
+	}
+	
+	size_t prefix_state = 0;
+	bool prefix_alive = !prefixes.edges.empty();
+	size_t substring_state = 0;
+	
+	if(!components.empty()) {
+		size_t pos = 0;
+		while(true) {
+			
+			size_t end = path.find(path_sep, pos);
+			if(end == std::string::npos) {
+				end = path.size();
+			}
+			
+			component_id id = lookup(path, pos, end);
+			
+			if(prefix_alive) {
+				prefix_state = id ? prefixes.next(prefix_state, id) : 0;
+				if(prefix_state == 0) {
+					prefix_alive = false;
+				} else if(prefixes.accept[prefix_state]) {
+					return true;
+				}
+			}
+			
+			if(id == 0) {
+				substring_state = 0;
+			} else {
+				size_t next = substrings.next(substring_state, id);
+				while(next == 0 && substring_state != 0) {
+					substring_state = substrings.fail[substring_state];
+					next = substrings.next(substring_state, id);
+				}
+				substring_state = next;
+				if(substrings.accept[substring_state]) {
+					return true;
+				}
+			}
+			
+			if(end == path.size()) {
+				break;
+			}
+			pos = end + 1;
+		}
+	}
+	
+	return !globs.empty() && match_globs(path);
+}
+
+bool path_filter::match_globs(const std::string & path) const {
+	
+	std::vector<range> parts;
+	size_t pos = 0;
+	while(true) {
+		size_t end = path.find(path_sep, pos);
+		if(end == std::string::npos) {
+			parts.push_back(range(pos, path.size()));
+			break;
+		}
+		parts.push_back(range(pos, end));
+		pos = end + 1;
+	}
+	
+	BOOST_FOREACH(const glob & g, globs) {
+		
+		if(g.components.size() > parts.size()) {
+			continue;
+		}
+		
+		size_t last_start = g.anchored ? 0 : parts.size() - g.components.size();
+		for(size_t start = 0; start <= last_start; start++) {
+			bool matched = true;
+			for(size_t i = 0; i < g.components.size() && matched; i++) {
+				const range & part = parts[start + i];
+				matched = component_match(g.components[i], path, part.first, part.second);
+			}
+			if(matched) {
+				return true;
+			}
+		}
+		
+	}
+	
+	return false;
+}
+
+} // namespace setup
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Compiled matcher for path patterns as used by the \c --include option.
+ */
+#ifndef INNOEXTRACT_SETUP_FILTER_HPP
+#define INNOEXTRACT_SETUP_FILTER_HPP
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace setup {
+
+/*!
+ * Matcher for a set of path patterns.
+ *
+ * Patterns consist of one or more path components separated by \ref path_sep.
+ * A pattern starting with a separator only matches the first components of a path.
+ * Other patterns match any sequence of consecutive components in the path.
+ * Components are always matched completely.
+ *
+ * Pattern components containing \c *, \c ? or \c [ are also matched as shell-style
+ * wildcards that do not cross separators.
+ *
+ * Literal patterns are compiled into a trie of component IDs (for anchored patterns)
+ * and an Aho-Corasick automaton over component IDs (for all other patterns), so the
+ * cost of a match is linear in the length of the path and independent of the number of
+ * literal patterns.
+ */
+class path_filter {
+	
+public:
+	
+	path_filter() : compiled(true) { }
+	
+	//! Add a pattern to match against.
+	void add(const std::string & pattern);
+	
+	//! Prepare the added patterns for matching. Must be called before \ref match().
+	void compile();
+	
+	//! \return true if no patterns have been added.
+	bool empty() const { return patterns.empty(); }
+	
+	//! \return true if the path matches any of the patterns.
+	bool match(const std::string & path) const;
+	
+private:
+	
+	typedef boost::uint32_t component_id; //!< \c 0 for components not used in any pattern
+	
+	struct component_hash {
+		size_t operator()(const std::string & component) const;
+	};
+	
+	typedef boost::unordered_map<std::string, component_id, component_hash> component_map;
+	
+	//! Trie of component IDs with optional Aho-Corasick failure links.
+	struct automaton {
+		
+		typedef std::pair<size_t, component_id> edge;
+		
+		boost::unordered_map<edge, size_t> edges;
+		std::vector<size_t> fail;
+		std::vector<bool> accept;
+		
+		automaton() : fail(1, 0), accept(1, false) { }
+		
+		void insert(const std::vector<component_id> & components);
+		
+		//! \return the next state or \c 0 if there is no matching edge.
+		size_t next(size_t state, component_id component) const;
+		
+		void link();
+		
+	};
+	
+	struct glob {
+		bool anchored;
+		std::vector<std::string> components;
+	};
+	
+	typedef std::pair<size_t, size_t> range;
+	
+	component_id lookup(const std::string & path, size_t begin, size_t end) const;
+	
+	bool match_globs(const std::string & path) const;
+	
+	std::vector<std::string> patterns;
+	
+	component_map components;
+	automaton prefixes;   //!< Anchored literal patterns.
+	automaton substrings; //!< Unanchored literal patterns.
+	std::vector<glob> globs;
+	
+	bool compiled;
+	
+};
+
+} // namespace setup
+
+#endif // INNOEXTRACT_SETUP_FILTER_HPP
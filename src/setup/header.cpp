@@ -124,7 +124,7 @@ STORED_ENUM_MAP(stored_compression_method_3, stream::UnknownCompression,
 
 } // anonymous namespace
 
-void header::load(std::istream & is, const version & version) {
+void header::load(util::span_reader & is, const version & version) {
 	
 	options = 0;
 	
@@ -311,14 +311,14 @@ void header::load(std::istream & is, const version & version) {
 		password.crc32 = util::load<boost::uint32_t>(is);
 		password.type = crypto::CRC32;
 	} else if(version < INNO_VERSION(5, 3, 9)) {
-		is.read(password.md5, std::streamsize(sizeof(password.md5)));
+		is.read(password.md5, sizeof(password.md5));
 		password.type = crypto::MD5;
 	} else {
-		is.read(password.sha1, std::streamsize(sizeof(password.sha1)));
+		is.read(password.sha1, sizeof(password.sha1));
 		password.type = crypto::SHA1;
 	}
 	if(version >= INNO_VERSION(4, 2, 2)) {
-		is.read(password_salt, std::streamsize(sizeof(password_salt)));
+		is.read(password_salt, sizeof(password_salt));
 	} else {
 		std::memset(password_salt, 0, sizeof(password_salt));
 	}
@@ -585,19 +585,19 @@ void header::load(std::istream & is, const version & version) {
 		if(license_size > 0) {
 			std::string temp;
 			temp.resize(size_t(license_size));
-			is.read(&temp[0], license_size);
+			is.read(&temp[0], size_t(license_size));
 			util::to_utf8(temp, license_text);
 		}
 		if(info_before_size > 0) {
 			std::string temp;
 			temp.resize(size_t(info_before_size));
-			is.read(&temp[0], info_before_size);
+			is.read(&temp[0], size_t(info_before_size));
 			util::to_utf8(temp, info_before);
 		}
 		if(info_after_size > 0) {
 			std::string temp;
 			temp.resize(size_t(info_after_size));
-			is.read(&temp[0], info_after_size);
+			is.read(&temp[0], size_t(info_after_size));
 			util::to_utf8(temp, info_after);
 		}
 	}
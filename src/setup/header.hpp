@@ -29,7 +29,6 @@
 #include <stddef.h>
 #include <bitset>
 #include <string>
-#include <iosfwd>
 
 #include <boost/cstdint.hpp>
 
@@ -39,6 +38,8 @@
 #include "util/enum.hpp"
 #include "util/flags.hpp"
 
+namespace util { class span_reader; }
+
 namespace setup {
 
 struct version;
@@ -254,7 +255,7 @@ struct header {
 	
 	flags options;
 	
-	void load(std::istream & is, const version & version);
+	void load(util::span_reader & is, const version & version);
 	
 };
 
@@ -36,7 +36,7 @@ STORED_ENUM_MAP(stored_close_setting, icon_entry::NoSetting,
 
 } // anonymous namespace
 
-void icon_entry::load(std::istream & is, const version & version) {
+void icon_entry::load(util::span_reader & is, const version & version) {
 	
 	if(version < INNO_VERSION(1, 3, 21)) {
 		(void)util::load<boost::uint32_t>(is); // uncompressed size of the entry
@@ -51,22 +51,22 @@ namespace {
 struct no_arg { };
 
 template <class Entry, class Arg>
-static void load_entry(std::istream & is, const setup::version & version,
-                       Entry & entity, Arg arg) {
+static void load_entry(util::span_reader & is, const setup::version & version,
+                       Entry & entity, const Arg & arg) {
 	entity.load(is, version, arg);
 }
 template <class Entry>
-static void load_entry(std::istream & is, const setup::version & version,
-                                    Entry & entity, no_arg arg) {
+static void load_entry(util::span_reader & is, const setup::version & version,
+                                    Entry & entity, const no_arg & arg) {
 	(void)arg;
 	entity.load(is, version);
 }
 
 template <class Entry, class Arg>
-static void load_entries(std::istream & is, const setup::version & version,
+static void load_entries(util::span_reader & is, const setup::version & version,
                   info::entry_types entry_types, size_t count,
                   std::vector<Entry> & entries, info::entry_types::enum_type entry_type,
-                  Arg arg = Arg()) {
+                  const Arg & arg = Arg()) {
 	
 	entries.clear();
 	if(entry_types & entry_type) {
@@ -84,13 +84,13 @@ static void load_entries(std::istream & is, const setup::version & version,
 }
 
 template <class Entry>
-static void load_entries(std::istream & is, const setup::version & version,
+static void load_entries(util::span_reader & is, const setup::version & version,
                   info::entry_types entry_types, size_t count,
                   std::vector<Entry> & entries, info::entry_types::enum_type entry_type) {
 	load_entries<Entry, no_arg>(is, version, entry_types, count, entries, entry_type);
 }
 
-static void load_wizard_and_decompressor(std::istream & is, const setup::version & version,
+static void load_wizard_and_decompressor(util::span_reader & is, const setup::version & version,
                                         const setup::header & header,
                                         setup::info & info, info::entry_types entries) {
 	
@@ -136,60 +136,215 @@ static void load_wizard_and_decompressor(std::istream & is, const setup::version
 
 } // anonymous namespace
 
-static void check_is_end(stream::block_reader::pointer & is, const char * what) {
-	is->exceptions(std::ios_base::goodbit);
-	char dummy;
-	if(!is->get(dummy).eof()) {
+static void check_is_end(util::span_reader & is, const char * what) {
+	if(!is.eof()) {
 		throw std::ios_base::failure(what);
 	}
 }
 
-void info::load(std::istream & ifs, entry_types e, const setup::version & v) {
+namespace {
+
+//! Open a header block stream that does not throw at the end of the data.
+stream::block_reader::pointer open_block(std::istream & base, const setup::version & version) {
 	
-	if(e & (Messages | NoSkip)) {
-		e |= Languages;
+	stream::block_reader::pointer is = stream::block_reader::get(base, version);
+	
+	// Only throw for decompression or checksum errors, not at the end of the stream
+	is->exceptions(std::ios_base::badbit);
+	
+	return is;
+}
+
+//! Decompress a complete header block stream into memory.
+void read_block(std::istream & base, const setup::version & version, std::string & data) {
+	
+	stream::block_reader::pointer is = open_block(base, version);
+	
+	data.clear();
+	char buffer[8192];
+	while(!is->eof()) {
+		is->read(buffer, std::streamsize(sizeof(buffer)));
+		data.append(buffer, size_t(is->gcount()));
 	}
+}
+
+/*!
+ * Check if two versions use the same format for the compressed header block streams.
+ * See \ref stream::block_reader::get.
+ */
+bool same_block_format(version_constant a, version_constant b) {
+	return (a >= INNO_VERSION(4, 0, 9)) == (b >= INNO_VERSION(4, 0, 9))
+	    && (a >= INNO_VERSION(4, 1, 6)) == (b >= INNO_VERSION(4, 1, 6));
+}
+
+/*!
+ * Mark entry types as loaded.
+ *
+ * \return true if there are no more entries left to load.
+ */
+bool loaded(info::entry_types & pending, info::entry_types types) {
+	pending &= ~types;
+	return !pending;
+}
+
+} // anonymous namespace
+
+void info::load_headers(util::span_reader & is, entry_types e, const setup::version & v,
+                        bool parse_all) {
 	
-	stream::block_reader::pointer is = stream::block_reader::get(ifs, v);
+	// Entries after the point where parsing stops are not loaded
+	languages.clear();
+	messages.clear();
+	permissions.clear();
+	types.clear();
+	components.clear();
+	tasks.clear();
+	directories.clear();
+	files.clear();
+	icons.clear();
+	ini_entries.clear();
+	registry_entries.clear();
+	delete_entries.clear();
+	uninstall_delete_entries.clear();
+	run_entries.clear();
+	uninstall_run_entries.clear();
+	wizard_image.clear();
+	wizard_image_small.clear();
+	decompressor_dll.clear();
+	decrypt_dll.clear();
 	
-	header.load(*is, v);
+	// Requested entry types not loaded yet - NoSkip is never cleared
+	entry_types pending = e & ~entry_types(DataEntries);
+	if(parse_all) {
+		pending |= NoSkip;
+	}
 	
-	load_entries(*is, v, e, header.language_count, languages, Languages);
+	header.load(is, v);
+	if(!pending) {
+		return;
+	}
+	
+	load_entries(is, v, e, header.language_count, languages, Languages);
+	if(loaded(pending, Languages)) {
+		return;
+	}
 	
 	if(v < INNO_VERSION(4, 0, 0)) {
-		load_wizard_and_decompressor(*is, v, header, *this, e);
-	}
-	
-	load_entries(*is, v, e, header.message_count, messages, Messages, languages);
-	load_entries(*is, v, e, header.permission_count, permissions, Permissions);
-	load_entries(*is, v, e, header.type_count, types, Types);
-	load_entries(*is, v, e, header.component_count, components, Components);
-	load_entries(*is, v, e, header.task_count, tasks, Tasks);
-	load_entries(*is, v, e, header.directory_count, directories, Directories);
-	load_entries(*is, v, e, header.file_count, files, Files);
-	load_entries(*is, v, e, header.icon_count, icons, Icons);
-	load_entries(*is, v, e, header.ini_entry_count, ini_entries, IniEntries);
-	load_entries(*is, v, e, header.registry_entry_count, registry_entries, RegistryEntries);
-	load_entries(*is, v, e, header.delete_entry_count, delete_entries, DeleteEntries);
-	load_entries(*is, v, e, header.uninstall_delete_entry_count, uninstall_delete_entries,
+		load_wizard_and_decompressor(is, v, header, *this, e);
+		if(loaded(pending, WizardImages | DecompressorDll | DecryptDll)) {
+			return;
+		}
+	}
+	
+	load_entries(is, v, e, header.message_count, messages, Messages, languages);
+	if(loaded(pending, Messages)) {
+		return;
+	}
+	load_entries(is, v, e, header.permission_count, permissions, Permissions);
+	if(loaded(pending, Permissions)) {
+		return;
+	}
+	load_entries(is, v, e, header.type_count, types, Types);
+	if(loaded(pending, Types)) {
+		return;
+	}
+	load_entries(is, v, e, header.component_count, components, Components);
+	if(loaded(pending, Components)) {
+		return;
+	}
+	load_entries(is, v, e, header.task_count, tasks, Tasks);
+	if(loaded(pending, Tasks)) {
+		return;
+	}
+	load_entries(is, v, e, header.directory_count, directories, Directories);
+	if(loaded(pending, Directories)) {
+		return;
+	}
+	load_entries(is, v, e, header.file_count, files, Files, file_entry::layout(v));
+	if(loaded(pending, Files)) {
+		return;
+	}
+	load_entries(is, v, e, header.icon_count, icons, Icons);
+	if(loaded(pending, Icons)) {
+		return;
+	}
+	load_entries(is, v, e, header.ini_entry_count, ini_entries, IniEntries);
+	if(loaded(pending, IniEntries)) {
+		return;
+	}
+	load_entries(is, v, e, header.registry_entry_count, registry_entries, RegistryEntries);
+	if(loaded(pending, RegistryEntries)) {
+		return;
+	}
+	load_entries(is, v, e, header.delete_entry_count, delete_entries, DeleteEntries);
+	if(loaded(pending, DeleteEntries)) {
+		return;
+	}
+	load_entries(is, v, e, header.uninstall_delete_entry_count, uninstall_delete_entries,
 	             UninstallDeleteEntries);
-	load_entries(*is, v, e, header.run_entry_count, run_entries, RunEntries);
-	load_entries(*is, v, e, header.uninstall_run_entry_count, uninstall_run_entries,
+	if(loaded(pending, UninstallDeleteEntries)) {
+		return;
+	}
+	load_entries(is, v, e, header.run_entry_count, run_entries, RunEntries);
+	if(loaded(pending, RunEntries)) {
+		return;
+	}
+	load_entries(is, v, e, header.uninstall_run_entry_count, uninstall_run_entries,
 	             UninstallRunEntries);
+	if(loaded(pending, UninstallRunEntries)) {
+		return;
+	}
 	
 	if(v >= INNO_VERSION(4, 0, 0)) {
-		load_wizard_and_decompressor(*is, v, header, *this, e);
+		load_wizard_and_decompressor(is, v, header, *this, e);
 	}
 	
-	// restart the compression stream
 	check_is_end(is, "unknown data at end of primary header stream");
-	is = stream::block_reader::get(ifs, v);
+}
+
+void info::load_data_entries(util::span_reader & is, entry_types e,
+                             const setup::version & v) {
 	
-	load_entries(*is, v, e, header.data_entry_count, data_entries, DataEntries);
+	load_entries(is, v, e, header.data_entry_count, data_entries, DataEntries,
+	             data_entry::layout(v));
 	
 	check_is_end(is, "unknown data at end of secondary header stream");
 }
 
+void info::load(std::istream & is, entry_types e, const setup::version & v) {
+	
+	if(e & (Messages | NoSkip)) {
+		e |= Languages;
+	}
+	
+	std::streampos start = is.tellg();
+	
+	// Decompress the primary header block into memory while parsing it and stop as soon
+	// as all requested entries are loaded. Parsing from memory is a lot faster than
+	// reading the individual fields through the decompression stream.
+	std::string data;
+	{
+		stream::block_reader::pointer block = open_block(is, v);
+		util::span_reader reader(*block, data);
+		load_headers(reader, e, v);
+	}
+	
+	// The secondary block only contains the data entries
+	data_entries.clear();
+	if(!(e & (DataEntries | NoSkip))) {
+		return;
+	}
+	
+	// Parsing may have stopped before the end of the primary block
+	is.clear();
+	is.seekg(start);
+	stream::block_reader::skip(is, v);
+	
+	read_block(is, v, data);
+	util::span_reader reader(data);
+	load_data_entries(reader, e, v);
+}
+
 void info::load(std::istream & is, entry_types entries) {
 	
 	version.load(is);
@@ -199,37 +354,55 @@ void info::load(std::istream & is, entry_types entries) {
 		            << color::white << version << color::reset;
 	}
 	
-	version_constant listed_version = version.value;
-	
 	// Some setup versions didn't increment the data version number when they should have.
 	// To work around this, we try to parse the headers for both data versions.
-	bool ambiguous = version.is_ambiguous();
-	if(ambiguous) {
-		// Force parsing all headers so that we don't miss any errors.
-		entries |= NoSkip;
+	if(version.known && !version.is_ambiguous()) {
+		load(is, entries, version);
+		return;
 	}
-	if(!version.known || ambiguous) {
-		std::ios_base::streampos start = is.tellg();
+	
+	if(entries & (Messages | NoSkip)) {
+		entries |= Languages;
+	}
+	
+	// Decompress the header blocks only once and then try each candidate version on the
+	// in-memory data. Both blocks are always parsed completely so that a wrong version
+	// is detected - entries that are not requested are still discarded.
+	version_constant listed_version = version.value;
+	std::ios_base::streampos start = is.tellg();
+	std::string primary, secondary;
+	version_constant block_version = 0;
+	bool have_blocks = false;
+	
+	for(bool first = true; ; first = false) {
 		try {
-			load(is, entries, version);
+			
+			if(!have_blocks || !same_block_format(block_version, version.value)) {
+				have_blocks = false;
+				is.clear();
+				is.seekg(start);
+				read_block(is, version, primary);
+				read_block(is, version, secondary);
+				block_version = version.value;
+				have_blocks = true;
+			}
+			
+			util::span_reader primary_reader(primary);
+			load_headers(primary_reader, entries, version, true);
+			util::span_reader secondary_reader(secondary);
+			load_data_entries(secondary_reader, entries, version);
+			
 			return;
+			
 		} catch(...) {
-			version.value = version.next();
-			if(!version) {
+			version_constant next = version.next();
+			if(!first || !next) {
 				version.value = listed_version;
 				throw;
 			}
-			is.clear();
-			is.seekg(start);
+			version.value = next;
 		}
 	}
-	
-	try {
-		load(is, entries, version);
-	} catch(...) {
-		version.value = listed_version;
-		throw;
-	}
 }
 
 info::info() { }
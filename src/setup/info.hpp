@@ -26,6 +26,7 @@
 #ifndef INNOEXTRACT_SETUP_INFO_HPP
 #define INNOEXTRACT_SETUP_INFO_HPP
 
+#include <string>
 #include <vector>
 #include <iosfwd>
 
@@ -33,6 +34,8 @@
 #include "setup/version.hpp"
 #include "util/flags.hpp"
 
+namespace util { class span_reader; }
+
 namespace setup {
 
 struct component_entry;
@@ -123,6 +126,10 @@ struct info {
 	 *                identifier whose position is given by
 	 *                \ref loader::offsets::header_offset.
 	 * \param entries What kinds of entries to load.
+	 *
+	 * Unless \c NoSkip is given, the primary header block is only decompressed up to the
+	 * last requested kind of entries and the secondary block is only read if
+	 * \c DataEntries are requested. Entries that are not requested are left empty.
 	 */
 	void load(std::istream & is, entry_types entries);
 	
@@ -141,6 +148,21 @@ struct info {
 	 */
 	void load(std::istream & is, entry_types entries, const setup::version & version);
 	
+private:
+	
+	/*!
+	 * Parse the primary header stream.
+	 *
+	 * Stops reading after the last requested kind of entries unless \c NoSkip is given
+	 * or \c parse_all is true. Entries that are not requested are discarded either way.
+	 */
+	void load_headers(util::span_reader & is, entry_types entries,
+	                  const setup::version & version, bool parse_all = false);
+	
+	//! Parse the secondary header stream containing the data entries.
+	void load_data_entries(util::span_reader & is, entry_types entries,
+	                       const setup::version & version);
+	
 };
 
 } // namespace setup
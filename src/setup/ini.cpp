@@ -40,7 +40,7 @@ STORED_FLAGS_MAP(stored_ini_flags,
 
 } // anonymous namespace
 
-void ini_entry::load(std::istream & is, const version & version) {
+void ini_entry::load(util::span_reader & is, const version & version) {
 	
 	if(version < INNO_VERSION(1, 3, 21)) {
 		(void)util::load<boost::uint32_t>(is); // uncompressed size of the entry
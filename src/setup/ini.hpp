@@ -27,12 +27,13 @@
 #define INNOEXTRACT_SETUP_INI_HPP
 
 #include <string>
-#include <iosfwd>
 
 #include "setup/item.hpp"
 #include "util/enum.hpp"
 #include "util/flags.hpp"
 
+namespace util { class span_reader; }
+
 namespace setup {
 
 struct version;
@@ -54,7 +55,7 @@ struct ini_entry : public item {
 	
 	flags options;
 	
-	void load(std::istream & is, const version & version);
+	void load(util::span_reader & is, const version & version);
 	
 };
 
@@ -25,7 +25,7 @@
 
 namespace setup {
 
-void item::load_condition_data(std::istream & is, const version & version) {
+void item::load_condition_data(util::span_reader & is, const version & version) {
 	
 	if(version >= INNO_VERSION(2, 0, 0)) {
 		is >> util::encoded_string(components, version.codepage());
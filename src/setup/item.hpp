@@ -27,10 +27,11 @@
 #define INNOEXTRACT_SETUP_ITEM_HPP
 
 #include <string>
-#include <iosfwd>
 
 #include "setup/windows.hpp"
 
+namespace util { class span_reader; }
+
 namespace setup {
 
 struct version;
@@ -49,9 +50,9 @@ struct item {
 	
 protected:
 	
-	void load_condition_data(std::istream & is, const version & version);
+	void load_condition_data(util::span_reader & is, const version & version);
 	
-	void load_version_data(std::istream & is, const version & version) {
+	void load_version_data(util::span_reader & is, const version & version) {
 		winver.load(is, version);
 	}
 	
@@ -27,10 +27,11 @@
 #define INNOEXTRACT_SETUP_LANGUAGE_HPP
 
 #include <string>
-#include <iosfwd>
 
 #include <boost/cstdint.hpp>
 
+namespace util { class span_reader; }
+
 namespace setup {
 
 struct version;
@@ -60,7 +61,7 @@ struct language_entry {
 	
 	bool right_to_left;
 	
-	void load(std::istream & is, const version & version);
+	void load(util::span_reader & is, const version & version);
 	
 };
 
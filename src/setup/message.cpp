@@ -29,7 +29,7 @@
 
 namespace setup {
 
-void message_entry::load(std::istream & is, const version & version,
+void message_entry::load(util::span_reader & is, const version & version,
                          const std::vector<language_entry> & languages) {
 	
 	is >> util::encoded_string(name, version.codepage());
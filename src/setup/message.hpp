@@ -27,9 +27,10 @@
 #define INNOEXTRACT_SETUP_MESSAGE_HPP
 
 #include <string>
-#include <iosfwd>
 #include <vector>
 
+namespace util { class span_reader; }
+
 namespace setup {
 
 struct version;
@@ -48,7 +49,7 @@ struct message_entry {
 	// Index into the default language entry list or -1.
 	int language;
 	
-	void load(std::istream & is, const version & version,
+	void load(util::span_reader & is, const version & version,
 	          const std::vector<language_entry> & languages);
 	
 };
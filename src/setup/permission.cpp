@@ -25,7 +25,7 @@
 
 namespace setup {
 
-void permission_entry::load(std::istream & is, const version & v) {
+void permission_entry::load(util::span_reader & is, const version & v) {
 	
 	(void)v;
 	
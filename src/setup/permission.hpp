@@ -27,7 +27,8 @@
 #define INNOEXTRACT_SETUP_PERMISSION_HPP
 
 #include <string>
-#include <iosfwd>
+
+namespace util { class span_reader; }
 
 namespace setup {
 
@@ -39,7 +40,7 @@ struct permission_entry {
 	
 	std::string permissions;
 	
-	void load(std::istream & is, const version & version);
+	void load(util::span_reader & is, const version & version);
 	
 };
 
@@ -58,7 +58,7 @@ STORED_ENUM_MAP(stored_registry_entry_type_2, registry_entry::None,
 
 } // anonymous namespace
 
-void registry_entry::load(std::istream & is, const version & version) {
+void registry_entry::load(util::span_reader & is, const version & version) {
 	
 	if(version < INNO_VERSION(1, 3, 21)) {
 		(void)util::load<boost::uint32_t>(is); // uncompressed size of the entry
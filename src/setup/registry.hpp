@@ -27,13 +27,14 @@
 #define INNOEXTRACT_SETUP_REGISTRY_HPP
 
 #include <string>
-#include <iosfwd>
 
 #include "setup/item.hpp"
 #include "setup/windows.hpp"
 #include "util/enum.hpp"
 #include "util/flags.hpp"
 
+namespace util { class span_reader; }
+
 namespace setup {
 
 struct version;
@@ -90,7 +91,7 @@ struct registry_entry : public item {
 	
 	flags options;
 	
-	void load(std::istream & is, const version & version);
+	void load(util::span_reader & is, const version & version);
 	
 };
 
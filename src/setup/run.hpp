@@ -27,12 +27,13 @@
 #define INNOEXTRACT_SETUP_RUN_HPP
 
 #include <string>
-#include <iosfwd>
 
 #include "setup/item.hpp"
 #include "util/enum.hpp"
 #include "util/flags.hpp"
 
+namespace util { class span_reader; }
+
 namespace setup {
 
 struct version;
@@ -72,7 +73,7 @@ struct run_entry : public item {
 	
 	flags options;
 	
-	void load(std::istream & is, const version & version);
+	void load(util::span_reader & is, const version & version);
 	
 };
 
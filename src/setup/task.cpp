@@ -28,7 +28,7 @@
 
 namespace setup {
 
-void task_entry::load(std::istream & is, const version & version) {
+void task_entry::load(util::span_reader & is, const version & version) {
 	
 	is >> util::encoded_string(name, version.codepage());
 	is >> util::encoded_string(description, version.codepage());
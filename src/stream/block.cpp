@@ -150,16 +150,15 @@ NAMES(stream::block_compression, "Compression",
 
 namespace stream {
 
-block_reader::pointer block_reader::get(std::istream & base, const setup::version & version) {
-	
-	USE_ENUM_NAMES(block_compression)
+//! Read the header of a block stream and return the stored size and compression.
+static boost::uint32_t read_block_header(std::istream & base, const setup::version & version,
+                                         block_compression & compression) {
 	
 	boost::uint32_t expected_checksum = util::load<boost::uint32_t>(base);
 	crypto::crc32 actual_checksum;
 	actual_checksum.init();
 	
 	boost::uint32_t stored_size;
-	block_compression compression;
 	
 	if(version >= INNO_VERSION(4, 0, 9)) {
 		
@@ -187,6 +186,16 @@ block_reader::pointer block_reader::get(std::istream & base, const setup::versio
 		throw block_error("block header CRC32 mismatch");
 	}
 	
+	return stored_size;
+}
+
+block_reader::pointer block_reader::get(std::istream & base, const setup::version & version) {
+	
+	USE_ENUM_NAMES(block_compression)
+	
+	block_compression compression;
+	boost::uint32_t stored_size = read_block_header(base, version, compression);
+	
 	debug("[block] size: " << stored_size << "  compression: " << compression);
 	
 	util::unique_ptr<io::filtering_istream>::type fis(new io::filtering_istream);
@@ -211,4 +220,12 @@ block_reader::pointer block_reader::get(std::istream & base, const setup::versio
 	return pointer(fis.release());
 }
 
+void block_reader::skip(std::istream & base, const setup::version & version) {
+	
+	block_compression compression;
+	boost::uint32_t stored_size = read_block_header(base, version, compression);
+	
+	base.seekg(stored_size, std::ios_base::cur);
+}
+
 } // namespace stream
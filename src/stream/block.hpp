@@ -80,6 +80,18 @@ public:
 	 */
 	static pointer get(std::istream & base, const setup::version & version);
 	
+	/*!
+	 * Skip over a header block without decompressing it.
+	 *
+	 * \param base    The input stream for the main setup files.
+	 *                It must be positioned at start of the block stream and will be
+	 *                positioned directly after the block stream when this function returns.
+	 * \param version The version of the setup data.
+	 *
+	 * \throws block_error if the block stream header checksum was invalid.
+	 */
+	static void skip(std::istream & base, const setup::version & version);
+	
 };
 
 } // namespace stream
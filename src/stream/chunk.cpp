@@ -62,16 +62,26 @@ bool chunk::operator==(const chunk & o) const {
 	        && encrypted == o.encrypted);
 }
 
-chunk_reader::pointer chunk_reader::get(slice_reader & base, const chunk & chunk) {
-	
+static void seek_to_chunk(slice_reader & base, const chunk & chunk) {
 	if(!base.seek(chunk.first_slice, chunk.offset)) {
 		throw chunk_error("could not seek to chunk start");
 	}
-	
+}
+
+static void check_chunk_magic(slice_reader & base) {
 	char magic[sizeof(chunk_id)];
 	if(base.read(magic, 4) != 4 || memcmp(magic, chunk_id, sizeof(chunk_id))) {
 		throw chunk_error("bad chunk magic");
 	}
+}
+
+chunk_reader::pointer chunk_reader::get(slice_reader & base, const chunk & chunk) {
+	
+	seek_to_chunk(base, chunk);
+	
+	base.advise(chunk.first_slice, chunk.offset, sizeof(chunk_id) + chunk.size);
+	
+	check_chunk_magic(base);
 	
 	pointer result(new boost::iostreams::chain<boost::iostreams::input>);
 	
@@ -95,6 +105,51 @@ chunk_reader::pointer chunk_reader::get(slice_reader & base, const chunk & chunk
 	return result;
 }
 
+boost::uint64_t chunk_reader::memory_usage(slice_reader & base, const chunk & chunk) {
+	
+	switch(chunk.compression) {
+		
+		case Stored: return 0;
+		
+		// 32 KiB window plus the inflate state
+		case Zlib: return 48 * 1024;
+		
+		case BZip2: {
+			// The stream header stores the block size in units of 100000 bytes
+			seek_to_chunk(base, chunk);
+			check_chunk_magic(base);
+			char header[4];
+			if(base.read(header, 4) != 4 || header[3] < '1' || header[3] > '9') {
+				throw chunk_error("bad bzip2 header");
+			}
+			return 100000 + 400000 * boost::uint64_t(header[3] - '0');
+		}
+		
+	#if INNOEXTRACT_HAVE_LZMA
+		case LZMA1: {
+			seek_to_chunk(base, chunk);
+			check_chunk_magic(base);
+			char header[5];
+			if(base.read(header, 5) != 5) {
+				throw chunk_error("could not read lzma1 header");
+			}
+			return inno_lzma1_memory_usage(header);
+		}
+		case LZMA2: {
+			seek_to_chunk(base, chunk);
+			check_chunk_magic(base);
+			char header;
+			if(base.read(&header, 1) != 1) {
+				throw chunk_error("could not read lzma2 header");
+			}
+			return inno_lzma2_memory_usage(header);
+		}
+	#endif
+		
+		default: return 0;
+	}
+}
+
 } // namespace stream
 
 NAMES(stream::compression_method, "Compression Method",
@@ -111,6 +111,21 @@ public:
 	 */
 	static pointer get(slice_reader & base, const ::stream::chunk & chunk);
 	
+	/*!
+	 * Estimate the amount of memory needed to decompress a chunk.
+	 *
+	 * This reads the compression properties from the start of the chunk.
+	 * The position of \c base is changed.
+	 *
+	 * \param base  The slice reader for the setup file(s).
+	 * \param chunk Information specifying the chunk.
+	 *
+	 * \throws chunk_error if the chunk header could not be read or was invalid.
+	 *
+	 * \return the approximate decoder memory usage in bytes.
+	 */
+	static boost::uint64_t memory_usage(slice_reader & base, const ::stream::chunk & chunk);
+	
 };
 
 } // namespace stream
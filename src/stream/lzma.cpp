@@ -31,14 +31,31 @@
 
 namespace stream {
 
-static lzma_stream * init_raw_lzma_stream(lzma_vli filter, lzma_options_lzma & options) {
+static void check_dict_size(const lzma_options_lzma & options) {
+	if(options.dict_size > (boost::uint32_t(1) << 28)) {
+		throw lzma_error("inno lzma dict size too large", LZMA_FORMAT_ERROR);
+	}
+}
+
+static boost::uint64_t raw_lzma_memory_usage(lzma_vli filter, lzma_options_lzma & options) {
 	
 	options.preset_dict = NULL;
+	check_dict_size(options);
 	
-	if(options.dict_size > (boost::uint32_t(1) << 28)) {
-		throw lzma_error("inno lzma dict size too large", LZMA_FORMAT_ERROR);
+	const lzma_filter filters[2] = { { filter,  &options }, { LZMA_VLI_UNKNOWN, NULL } };
+	boost::uint64_t usage = lzma_raw_decoder_memusage(filters);
+	if(usage == boost::uint64_t(-1)) {
+		throw lzma_error("inno lzma options error", LZMA_OPTIONS_ERROR);
 	}
 	
+	return usage;
+}
+
+static lzma_stream * init_raw_lzma_stream(lzma_vli filter, lzma_options_lzma & options) {
+	
+	options.preset_dict = NULL;
+	check_dict_size(options);
+	
 	lzma_stream * strm = new lzma_stream;
 	lzma_stream tmp = LZMA_STREAM_INIT;
 	*strm = tmp;
@@ -54,6 +71,45 @@ static lzma_stream * init_raw_lzma_stream(lzma_vli filter, lzma_options_lzma & o
 	return strm;
 }
 
+static void parse_lzma1_header(const char * header, lzma_options_lzma & options) {
+	
+	boost::uint8_t properties = boost::uint8_t(header[0]);
+	if(properties > (9 * 5 * 5)) {
+		throw lzma_error("inno lzma1 property error", LZMA_FORMAT_ERROR);
+	}
+	options.pb = properties / (9 * 5);
+	options.lp = (properties % (9 * 5)) / 9;
+	options.lc = properties % 9;
+	
+	options.dict_size = util::little_endian::load<boost::uint32_t>(header + 1);
+}
+
+static void parse_lzma2_header(char header, lzma_options_lzma & options) {
+	
+	boost::uint8_t prop = boost::uint8_t(header);
+	if(prop > 40) {
+		throw lzma_error("inno lzma2 property error", LZMA_FORMAT_ERROR);
+	}
+	
+	if(prop == 40) {
+		options.dict_size = 0xffffffff;
+	} else {
+		options.dict_size = ((boost::uint32_t(2) | boost::uint32_t((prop) & 1)) << ((prop) / 2 + 11));
+	}
+}
+
+boost::uint64_t inno_lzma1_memory_usage(const char * header) {
+	lzma_options_lzma options;
+	parse_lzma1_header(header, options);
+	return raw_lzma_memory_usage(LZMA_FILTER_LZMA1, options);
+}
+
+boost::uint64_t inno_lzma2_memory_usage(char header) {
+	lzma_options_lzma options;
+	parse_lzma2_header(header, options);
+	return raw_lzma_memory_usage(LZMA_FILTER_LZMA2, options);
+}
+
 bool lzma_decompressor_impl_base::filter(const char * & begin_in, const char * end_in,
                                          char * & begin_out, char * end_out, bool flush) {
 	
@@ -105,16 +161,7 @@ bool inno_lzma1_decompressor_impl::filter(const char * & begin_in, const char *
 		}
 		
 		lzma_options_lzma options;
-		
-		boost::uint8_t properties = boost::uint8_t(header[0]);
-		if(properties > (9 * 5 * 5)) {
-			throw lzma_error("inno lzma1 property error", LZMA_FORMAT_ERROR);
-		}
-		options.pb = properties / (9 * 5);
-		options.lp = (properties % (9 * 5)) / 9;
-		options.lc = properties % 9;
-		
-		options.dict_size = util::little_endian::load<boost::uint32_t>(header + 1);
+		parse_lzma1_header(header, options);
 		
 		stream = init_raw_lzma_stream(LZMA_FILTER_LZMA1, options);
 	}
@@ -133,17 +180,7 @@ bool inno_lzma2_decompressor_impl::filter(const char * & begin_in, const char *
 		}
 		
 		lzma_options_lzma options;
-		
-		boost::uint8_t prop = boost::uint8_t(*begin_in++);
-		if(prop > 40) {
-			throw lzma_error("inno lzma2 property error", LZMA_FORMAT_ERROR);
-		}
-		
-		if(prop == 40) {
-			options.dict_size = 0xffffffff;
-		} else {
-			options.dict_size = ((boost::uint32_t(2) | boost::uint32_t((prop) & 1)) << ((prop) / 2 + 11));
-		}
+		parse_lzma2_header(*begin_in++, options);
 		
 		stream = init_raw_lzma_stream(LZMA_FILTER_LZMA2, options);
 	}
@@ -33,6 +33,7 @@
 #include <stddef.h>
 #include <iosfwd>
 
+#include <boost/cstdint.hpp>
 #include <boost/iostreams/filter/symmetric.hpp>
 #include <boost/noncopyable.hpp>
 
@@ -131,6 +132,24 @@ typedef lzma_decompressor<inno_lzma1_decompressor_impl> inno_lzma1_decompressor;
  */
 typedef lzma_decompressor<inno_lzma2_decompressor_impl> inno_lzma2_decompressor;
 
+/*!
+ * Get the amount of memory needed to decode an Inno Setup LZMA1 stream.
+ *
+ * \param header The first five bytes of the stream.
+ *
+ * \throws lzma_error if the header is invalid.
+ */
+boost::uint64_t inno_lzma1_memory_usage(const char * header);
+
+/*!
+ * Get the amount of memory needed to decode an Inno Setup LZMA2 stream.
+ *
+ * \param header The first byte of the stream.
+ *
+ * \throws lzma_error if the header is invalid.
+ */
+boost::uint64_t inno_lzma2_memory_usage(char header);
+
 } // namespace stream
 
 #endif // INNOEXTRACT_HAVE_LZMA
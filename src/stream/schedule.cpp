@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "stream/schedule.hpp"
+
+#include <algorithm>
+
+#include "stream/slice.hpp"
+
+namespace stream {
+
+namespace {
+
+//! Size of the magic number stored before each chunk.
+const boost::uint64_t chunk_header_size = 4;
+
+/*!
+ * Maximum gap between two chunks in the same slice for them to still be part of the
+ * same run. Reading over small gaps is cheaper than seeking on slow media.
+ */
+const boost::uint64_t max_gap = 512 * 1024;
+
+} // anonymous namespace
+
+void chunk_scheduler::add(const chunk & chunk) {
+	
+	if(!ordered.empty() && chunk < ordered.back()) {
+		sorted = false;
+	}
+	
+	ordered.push_back(chunk);
+}
+
+void chunk_scheduler::build() {
+	
+	if(!sorted) {
+		std::sort(ordered.begin(), ordered.end());
+		sorted = true;
+	}
+	
+	grouped.clear();
+	run_for_chunk.clear();
+	run_for_chunk.reserve(ordered.size());
+	
+	// End of the previous chunk, if it is known
+	size_t end_slice = 0;
+	boost::uint64_t end_offset = 0;
+	bool end_known = false;
+	
+	for(size_t i = 0; i < ordered.size(); i++) {
+		
+		const chunk & c = ordered[i];
+		boost::uint64_t size = chunk_header_size + c.size;
+		
+		bool extend = false;
+		if(!grouped.empty()) {
+			if(c.first_slice == end_slice) {
+				// Chunks that start where the last one ended, or shortly after
+				extend = !end_known || (c.offset >= end_offset && c.offset - end_offset <= max_gap);
+			} else if(c.first_slice == end_slice + 1) {
+				// Slices are filled completely before starting a new one
+				extend = !end_known;
+			}
+		}
+		
+		if(extend) {
+			run & r = grouped.back();
+			if(end_known && c.first_slice == end_slice) {
+				r.size += c.offset - end_offset;
+			}
+			r.size += size;
+		} else {
+			run r;
+			r.first_slice = c.first_slice;
+			r.offset = c.offset;
+			r.size = size;
+			r.first_chunk = i;
+			grouped.push_back(r);
+		}
+		
+		run_for_chunk.push_back(grouped.size() - 1);
+		
+		// We don't know the slice sizes so we can't tell where chunks spanning slices end
+		end_slice = c.last_slice;
+		end_known = (c.first_slice == c.last_slice);
+		end_offset = boost::uint64_t(c.offset) + size;
+	}
+}
+
+void chunk_scheduler::prepare(slice_reader & reader, size_t chunk) const {
+	
+	const run & r = grouped[run_for_chunk[chunk]];
+	
+	if(r.first_chunk == chunk) {
+		reader.advise(r.first_slice, r.offset, r.size);
+	}
+}
+
+} // namespace stream
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Plan for reading a set of \ref stream::chunk "chunks" with as little seeking as possible.
+ */
+#ifndef INNOEXTRACT_STREAM_SCHEDULE_HPP
+#define INNOEXTRACT_STREAM_SCHEDULE_HPP
+
+#include <stddef.h>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "stream/chunk.hpp"
+
+namespace stream {
+
+class slice_reader;
+
+/*!
+ * Plan for reading a set of chunks using a single \ref slice_reader.
+ *
+ * Chunks are read in the order they are stored in so that each slice file is opened
+ * only once and read from front to back.
+ * Consecutive chunks that are stored next to each other (possibly spanning slice
+ * boundaries) or only separated by a small gap are grouped into runs.
+ * Each run is announced to the \ref slice_reader as a whole when its first chunk is
+ * opened, allowing the reader to pre-load the data and to open the following slices in
+ * the background.
+ */
+class chunk_scheduler {
+	
+public:
+	
+	//! A contiguous byte range of the setup data that is read in one go.
+	struct run {
+		
+		size_t          first_slice; //!< Slice where the run starts.
+		boost::uint32_t offset;      //!< Offset of the run in the first slice.
+		boost::uint64_t size;        //!< Number of bytes in the run, possibly spanning slices.
+		
+		size_t          first_chunk; //!< Index of the first chunk in the run.
+		
+	};
+	
+	chunk_scheduler() : sorted(true) { }
+	
+	//! Add a chunk to be read.
+	void add(const chunk & chunk);
+	
+	//! Sort the chunks into read order and group them into runs.
+	void build();
+	
+	//! \return the chunks in the order they should be read - only valid after \ref build()
+	const std::vector<chunk> & chunks() const { return ordered; }
+	
+	//! \return the runs of adjacent chunks - only valid after \ref build()
+	const std::vector<run> & runs() const { return grouped; }
+	
+	/*!
+	 * Prepare the slice reader for reading the chunk with the given index.
+	 *
+	 * If the chunk starts a new run, the whole run is announced to the reader.
+	 *
+	 * \param reader The slice reader used to read the chunks.
+	 * \param chunk  Index of the chunk in \ref chunks().
+	 */
+	void prepare(slice_reader & reader, size_t chunk) const;
+	
+private:
+	
+	std::vector<chunk> ordered;
+	std::vector<run> grouped;
+	std::vector<size_t> run_for_chunk;
+	bool sorted;
+	
+};
+
+} // namespace stream
+
+#endif // INNOEXTRACT_STREAM_SCHEDULE_HPP
@@ -23,11 +23,24 @@
 #include <sstream>
 #include <cstring>
 #include <limits>
+#include <vector>
 
+#include "configure.hpp"
+
+#if INNOEXTRACT_HAVE_POSIX_FADVISE
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <boost/bind.hpp>
 #include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/range/size.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "util/console.hpp"
+#include "util/fstream.hpp"
 #include "util/load.hpp"
 #include "util/log.hpp"
 
@@ -40,13 +53,237 @@ const char slice_ids[][8] = {
 	{ 'i', 'd', 's', 'k', 'a', '3', '2', 0x1a },
 };
 
+//! How far ahead of the current read position to request data from the OS.
+const boost::uint32_t readahead_window = 8 * 1024 * 1024;
+
+//! Minimum amount of consumed data to release from the OS file cache at once.
+const boost::uint32_t release_granularity = 1024 * 1024;
+
 } // anonymous namespace
 
+//! An opened and validated external slice file.
+struct slice_reader::slice_handle : private boost::noncopyable {
+	
+	util::ifstream  stream;
+	path_type       file;
+	boost::uint32_t size;     //!< Size of the slice as stored in the slice header.
+	boost::uint32_t start;    //!< Offset of the first byte after the slice header.
+	
+#if INNOEXTRACT_HAVE_POSIX_FADVISE
+	int             fd;       //!< Separate descriptor used to pass access hints to the OS.
+	boost::uint32_t released; //!< Data before this offset has been released from the cache.
+	boost::uint32_t hinted;   //!< Data up to this offset has been requested from the OS.
+	boost::uint32_t hint_end; //!< End of the range that is expected to be read.
+#endif
+	
+	slice_handle();
+	~slice_handle() { close(); }
+	
+	/*!
+	 * Open and validate a slice file.
+	 *
+	 * \return \c false if the file could not be opened.
+	 *
+	 * \throws slice_error if the file is not a valid slice.
+	 */
+	bool open(const path_type & path);
+	
+	void close();
+	
+	/*!
+	 * Request data from the OS that is expected to be read soon.
+	 *
+	 * \return the number of bytes of the range that are not contained in this slice.
+	 */
+	boost::uint64_t need(boost::uint32_t offset, boost::uint64_t length);
+	
+	//! Update access hints after data up to the given offset has been read.
+	void update(boost::uint32_t position);
+	
+};
+
+slice_reader::slice_handle::slice_handle()
+	: size(0), start(0)
+#if INNOEXTRACT_HAVE_POSIX_FADVISE
+	, fd(-1), released(0), hinted(0), hint_end(0)
+#endif
+	{ }
+
+bool slice_reader::slice_handle::open(const path_type & path) {
+	
+	close();
+	
+	stream.open(path, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+	if(stream.fail()) {
+		return false;
+	}
+	
+	std::streampos file_size = stream.tellg();
+	stream.seekg(0);
+	
+	char magic[8];
+	if(stream.read(magic, 8).fail()) {
+		close();
+		throw slice_error("could not read slice magic number");
+	}
+	bool found = false;
+	for(size_t i = 0; i < size_t(boost::size(slice_ids)); i++) {
+		if(!std::memcmp(magic, slice_ids[i], 8)) {
+			found = true;
+			break;
+		}
+	}
+	if(!found) {
+		close();
+		throw slice_error("bad slice magic number");
+	}
+	
+	size = util::load<boost::uint32_t>(stream);
+	if(stream.fail()) {
+		close();
+		throw slice_error("could not read slice size");
+	} else if(std::streampos(size) > file_size) {
+		close();
+		std::ostringstream oss;
+		oss << "bad slice size: " << size << " > " << file_size;
+		throw slice_error(oss.str());
+	} else if(std::streampos(size) < stream.tellg()) {
+		close();
+		std::ostringstream oss;
+		oss << "bad slice size: " << size << " < " << stream.tellg();
+		throw slice_error(oss.str());
+	}
+	
+	file = path;
+	start = boost::uint32_t(stream.tellg());
+	
+#if INNOEXTRACT_HAVE_POSIX_FADVISE
+	// Failing to open this is not fatal - we just won't be able to give any hints
+	fd = ::open(path.string().c_str(), O_RDONLY);
+	if(fd >= 0) {
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+	released = hinted = hint_end = start;
+#endif
+	
+	return true;
+}
+
+void slice_reader::slice_handle::close() {
+	
+#if INNOEXTRACT_HAVE_POSIX_FADVISE
+	if(fd >= 0) {
+		// Release everything that was read or pre-loaded but not released yet
+		if(hinted > released) {
+			::posix_fadvise(fd, released, hinted - released, POSIX_FADV_DONTNEED);
+		}
+		::close(fd);
+		fd = -1;
+	}
+#endif
+	
+	stream.close();
+	stream.clear();
+}
+
+boost::uint64_t slice_reader::slice_handle::need(boost::uint32_t offset,
+                                                 boost::uint64_t length) {
+	
+	offset = std::max(offset, start);
+	boost::uint64_t available = (offset < size) ? size - offset : 0;
+	
+#if INNOEXTRACT_HAVE_POSIX_FADVISE
+	boost::uint32_t range_end = boost::uint32_t(offset + std::min(length, available));
+	if(offset >= released && range_end <= hint_end) {
+		// Already covered by an earlier announcement
+		return length - std::min(length, available);
+	}
+	hint_end = range_end;
+	hinted = offset;
+	if(offset < released) {
+		released = offset;
+	}
+	boost::uint32_t end = std::min(hint_end, boost::uint32_t(offset + readahead_window));
+	if(fd >= 0 && end > hinted) {
+		::posix_fadvise(fd, hinted, end - hinted, POSIX_FADV_WILLNEED);
+		hinted = end;
+	}
+#endif
+	
+	return length - std::min(length, available);
+}
+
+void slice_reader::slice_handle::update(boost::uint32_t position) {
+	
+#if INNOEXTRACT_HAVE_POSIX_FADVISE
+	
+	if(fd < 0) {
+		return;
+	}
+	
+	// Release data that has already been read
+	if(position < released) {
+		released = position;
+	} else if(position - released >= release_granularity) {
+		::posix_fadvise(fd, released, position - released, POSIX_FADV_DONTNEED);
+		released = position;
+	}
+	
+	// Keep the read-ahead window filled
+	hinted = std::max(hinted, position);
+	boost::uint32_t end = std::min(hint_end, boost::uint32_t(position + readahead_window));
+	if(end > hinted && (end == hint_end || end - hinted >= readahead_window / 4)) {
+		::posix_fadvise(fd, hinted, end - hinted, POSIX_FADV_WILLNEED);
+		hinted = end;
+	}
+	
+#else
+	(void)position;
+#endif
+	
+}
+
+//! Opens a slice file in a background thread.
+struct slice_reader::slice_prefetch : private boost::noncopyable {
+	
+	const size_t slice;
+	std::vector<path_type> candidates;       //!< Files to try, in order.
+	const boost::uint32_t offset;
+	const boost::uint64_t size;
+	boost::uint64_t remaining;               //!< Bytes of the range not in this slice.
+	boost::scoped_ptr<slice_handle> result;  //!< The opened slice or \c NULL on failure.
+	boost::thread thread;
+	
+	slice_prefetch(size_t slice, const std::vector<path_type> & candidates,
+	               boost::uint32_t offset, boost::uint64_t size)
+		: slice(slice), candidates(candidates), offset(offset), size(size), remaining(0),
+		  thread(boost::bind(&slice_prefetch::run, this)) { }
+	
+	~slice_prefetch() { thread.join(); }
+	
+	void run() {
+		try {
+			BOOST_FOREACH(const path_type & file, candidates) {
+				result.reset(new slice_handle);
+				if(result->open(file)) {
+					remaining = result->need(offset, size);
+					return;
+				}
+			}
+		} catch(...) {
+			// Errors are reported when the slice is opened in the foreground
+		}
+		result.reset();
+	}
+	
+};
+
 slice_reader::slice_reader(std::istream * istream, boost::uint32_t data_offset)
 	: data_offset(data_offset),
 	  dir(), last_dir(), base_file(), slices_per_disk(1),
 	  current_slice(0), slice_file(), slice_size(0),
-	  ifs(), is(istream) {
+	  current(), is(istream),
+	  prefetched(), advice_slice(0), advice_offset(0), advice_size(0) {
 	
 	std::streampos max_size = std::streampos(std::numeric_limits<boost::int32_t>::max());
 	
@@ -63,7 +300,13 @@ slice_reader::slice_reader(const path_type & dir, const std::string & base_file,
 	: data_offset(0),
 	  dir(dir), last_dir(dir), base_file(base_file), slices_per_disk(slices_per_disk),
 	  current_slice(0), slice_file(), slice_size(0),
-	  ifs(), is(&ifs) { }
+	  current(), is(NULL),
+	  prefetched(), advice_slice(0), advice_offset(0), advice_size(0) { }
+
+slice_reader::~slice_reader() {
+	// Wait for any background operations before closing the current slice
+	prefetched.reset();
+}
 
 void slice_reader::seek(size_t slice) {
 	
@@ -82,55 +325,11 @@ bool slice_reader::open_file(const path_type & file) {
 	
 	log_info << "opening \"" << color::cyan << file.string() << color::reset << '"';
 	
-	ifs.close();
-	ifs.clear();
-	
-	ifs.open(file, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
-	if(ifs.fail()) {
-		return false;
-	}
-	
-	std::streampos file_size = ifs.tellg();
-	ifs.seekg(0);
-	
-	char magic[8];
-	if(ifs.read(magic, 8).fail()) {
-		ifs.close();
-		throw slice_error("could not read slice magic number");
-	}
-	bool found = false;
-	for(size_t i = 0; boost::size(slice_ids); i++) {
-		if(!std::memcmp(magic, slice_ids[i], 8)) {
-			found = true;
-			break;
-		}
-	}
-	if(!found) {
-		ifs.close();
-		throw slice_error("bad slice magic number");
-	}
-	
-	slice_size = util::load<boost::uint32_t>(ifs);
-	if(ifs.fail()) {
-		ifs.close();
-		throw slice_error("could not read slice size");
-	} else if(std::streampos(slice_size) > file_size) {
-		ifs.close();
-		std::ostringstream oss;
-		oss << "bad slice size: " << slice_size << " > " << file_size;
-		throw slice_error(oss.str());
-	} else if(std::streampos(slice_size) < ifs.tellg()) {
-		ifs.close();
-		std::ostringstream oss;
-		oss << "bad slice size: " << slice_size << " < " << ifs.tellg();
-		throw slice_error(oss.str());
+	if(!current) {
+		current.reset(new slice_handle);
 	}
 	
-	slice_file = file;
-	
-	last_dir = file.parent_path();
-	
-	return true;
+	return current->open(file);
 }
 
 std::string slice_reader::slice_filename(const std::string & basename, size_t slice,
@@ -159,22 +358,93 @@ std::string slice_reader::slice_filename(const std::string & basename, size_t sl
 void slice_reader::open(size_t slice) {
 	
 	current_slice = slice;
-	is = &ifs;
-	ifs.close();
+	is = NULL;
+	current.reset();
+	
+	// Use the slice opened in the background if possible
+	boost::uint64_t remaining = 0;
+	if(prefetched && prefetched->slice == slice) {
+		prefetched->thread.join();
+		if(prefetched->result) {
+			current.swap(prefetched->result);
+			remaining = prefetched->remaining;
+			log_info << "opening \"" << color::cyan << current->file.string() << color::reset << '"';
+		}
+	}
+	prefetched.reset();
+	
+	if(!current) {
+		
+		path_type slice_file = slice_filename(base_file, slice, slices_per_disk);
+		
+		if(!open_file(last_dir / slice_file)
+		   && (dir == last_dir || !open_file(dir / slice_file))) {
+			current.reset();
+			std::ostringstream oss;
+			oss << "could not open slice " << slice << ": " << slice_file;
+			throw slice_error(oss.str());
+		}
+		
+	}
+	
+	is = &current->stream;
+	slice_size = current->size;
+	slice_file = current->file;
+	last_dir = slice_file.parent_path();
+	
+	if(remaining) {
+		prefetch(slice + 1, 0, remaining);
+	}
+	
+	if(advice_size && advice_slice == slice) {
+		apply_advice();
+	}
+}
+
+void slice_reader::prefetch(size_t slice, boost::uint32_t offset, boost::uint64_t size) {
+	
+	if(prefetched) {
+		return;
+	}
 	
+	std::vector<path_type> candidates;
 	path_type slice_file = slice_filename(base_file, slice, slices_per_disk);
+	candidates.push_back(last_dir / slice_file);
+	if(dir != last_dir) {
+		candidates.push_back(dir / slice_file);
+	}
+	
+	prefetched.reset(new slice_prefetch(slice, candidates, offset, size));
+}
+
+void slice_reader::apply_advice() {
+	
+	boost::uint64_t remaining = current->need(advice_offset, advice_size);
+	advice_size = 0;
+	
+	if(remaining) {
+		prefetch(current_slice + 1, 0, remaining);
+	}
+}
+
+void slice_reader::advise(size_t slice, boost::uint32_t offset, boost::uint64_t size) {
 	
-	if(open_file(last_dir / slice_file)) {
+	if(data_offset != 0 || size == 0) {
 		return;
 	}
 	
-	if(dir != last_dir && open_file(dir / slice_file)) {
+	advice_slice = slice, advice_offset = offset, advice_size = size;
+	
+	if(!is_open()) {
 		return;
 	}
 	
-	std::ostringstream oss;
-	oss << "could not open slice " << slice << ": " << slice_file;
-	throw slice_error(oss.str());
+	if(slice == current_slice) {
+		apply_advice();
+	} else if(slice == current_slice + 1 && !prefetched) {
+		prefetch(slice, offset, size);
+		advice_size = 0;
+	}
 }
 
 bool slice_reader::seek(size_t slice, boost::uint32_t offset) {
@@ -187,6 +457,11 @@ bool slice_reader::seek(size_t slice, boost::uint32_t offset) {
 		return false;
 	}
 	
+	// Seeking discards any buffered data - avoid it if we are already there
+	if(is->tellg() == std::streampos(offset)) {
+		return true;
+	}
+	
 	if(is->seekg(offset).fail()) {
 		return false;
 	}
@@ -222,6 +497,10 @@ std::streamsize slice_reader::read(char * buffer, std::streamsize bytes) {
 		
 		std::streamsize read = is->gcount();
 		nread += read, buffer += read, bytes -= read;
+		
+		if(current) {
+			current->update(read_pos + boost::uint32_t(read));
+		}
 	}
 	
 	return (nread != 0 || bytes == 0) ? nread : -1;
@@ -29,10 +29,10 @@
 #include <ios>
 #include <string>
 
+#include <boost/cstdint.hpp>
 #include <boost/iostreams/concepts.hpp>
 #include <boost/filesystem/path.hpp>
-
-#include "util/fstream.hpp"
+#include <boost/scoped_ptr.hpp>
 
 namespace stream {
 
@@ -53,11 +53,19 @@ struct slice_error : public std::ios_base::failure {
  * The contained data is made up of one or more \ref chunk "chunks"
  * (read by \ref chunk_reader), which in turn contain one or more  \ref file "files"
  * (read by \ref file_reader).
+ *
+ * When reading external slices, ranges announced via \ref advise() are pre-loaded by the
+ * OS and data that has already been read is released from the OS file cache.
+ * If an announced range continues in the next slice, that slice is opened and validated
+ * in the background.
  */
 class slice_reader : public boost::iostreams::source {
 	
 	typedef boost::filesystem::path path_type;
 	
+	struct slice_handle;
+	struct slice_prefetch;
+	
 	// Information for reading embedded setup data
 	const boost::uint32_t data_offset;
 	
@@ -73,12 +81,20 @@ class slice_reader : public boost::iostreams::source {
 	boost::uint32_t slice_size;    //!< Size in bytes of the currently opened slice.
 	
 	// Streams
-	util::ifstream ifs; //!< File input stream used when reading from external slices.
-	std::istream * is;  //!< Input stream to read from.
+	boost::scoped_ptr<slice_handle> current; //!< Currently opened external slice.
+	std::istream * is;                       //!< Input stream to read from.
+	
+	// Read-ahead state
+	boost::scoped_ptr<slice_prefetch> prefetched; //!< Next slice being opened in the background.
+	size_t          advice_slice;  //!< Slice containing the pending announced range.
+	boost::uint32_t advice_offset; //!< Start offset of the pending announced range.
+	boost::uint64_t advice_size;   //!< Size of the pending announced range, or \c 0 if none.
 	
 	void seek(size_t slice);
 	bool open_file(const path_type & file);
 	void open(size_t slice);
+	void prefetch(size_t slice, boost::uint32_t offset, boost::uint64_t size);
+	void apply_advice();
 	
 public:
 	
@@ -115,6 +131,8 @@ public:
 	 */
 	slice_reader(const path_type & dir, const std::string & basename, size_t slices_per_disk);
 	
+	~slice_reader();
+	
 	/*!
 	 * Attempt to seek to an offset within a slice.
 	 *
@@ -143,6 +161,19 @@ public:
 	 */
 	std::streamsize read(char * buffer, std::streamsize bytes);
 	
+	/*!
+	 * Announce that a range of bytes will be read soon.
+	 *
+	 * This is only a hint and has no effect on the data returned by \ref read().
+	 * It is ignored for setup data embedded in the setup executable.
+	 *
+	 * \param slice  The slice where the range starts.
+	 * \param offset The byte offset of the range within the given slice.
+	 * \param size   The number of bytes in the range. The range may continue in the
+	 *               following slices.
+	 */
+	void advise(size_t slice, boost::uint32_t offset, boost::uint64_t size);
+	
 	//! \return the number currently opened slice.
 	size_t slice() { return current_slice; }
 	
@@ -150,7 +181,7 @@ public:
 	path_type & file() { return slice_file; }
 	
 	//! \return true a slice is currently open.
-	bool is_open() { return (is != &ifs || ifs.is_open()); }
+	bool is_open() { return (is != NULL); }
 	
 };
 
@@ -0,0 +1,901 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Generator for synthetic Inno Setup installers to be used as test and benchmark fixtures.
+ *
+ * The written files mirror the layout parsed by \ref setup::info, \ref stream::block_reader,
+ * \ref stream::slice_reader and \ref stream::chunk_reader for a small set of setup data
+ * versions. All entries except those needed to describe the generated files are empty.
+ */
+
+#include <stddef.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/range/size.hpp>
+
+#include "configure.hpp"
+
+#if INNOEXTRACT_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#include "crypto/crc32.hpp"
+#include "crypto/sha1.hpp"
+#include "setup/version.hpp"
+#include "stream/chunk.hpp"
+#include "util/endian.hpp"
+#include "util/fstream.hpp"
+
+namespace fs = boost::filesystem;
+namespace io = boost::iostreams;
+namespace po = boost::program_options;
+
+namespace {
+
+enum ExitValues {
+	ExitSuccess = 0,
+	ExitUserError = 1,
+	ExitDataError = 2
+};
+
+struct fixture_version {
+	
+	const char * name;
+	
+	setup::version_constant version;
+	
+	bool unicode;
+	
+};
+
+//! Setup data versions the generator knows how to write.
+const fixture_version fixture_versions[] = {
+	{ "5.3.10",    INNO_VERSION(5, 3, 10), false },
+	{ "5.3.10u",   INNO_VERSION(5, 3, 10), true  },
+	{ "5.4.2",     INNO_VERSION(5, 4,  2), false },
+	{ "5.4.2u",    INNO_VERSION(5, 4,  2), true  },
+	{ "5.5.0",     INNO_VERSION(5, 5,  0), false },
+	{ "5.5.0u",    INNO_VERSION(5, 5,  0), true  },
+	{ "5.5.6",     INNO_VERSION(5, 5,  6), false },
+	{ "5.5.6u",    INNO_VERSION(5, 5,  6), true  },
+};
+
+const boost::uint32_t SetupLoaderHeaderOffset = 0x30;
+const boost::uint32_t SetupLoaderHeaderMagic = 0x6f6e6e49;
+const unsigned char setup_loader_magic[12] = {
+	'r', 'D', 'l', 'P', 't', 'S', 0xcd, 0xe6, 0xd7, '{', 0x0b, '*'
+};
+
+const char slice_magic[8] = { 'i', 'd', 's', 'k', 'a', '3', '2', 0x1a };
+const char chunk_magic[4] = { 'z', 'l', 'b', 0x1a };
+
+//! Size of the slice header: magic followed by the total slice size.
+const boost::uint32_t slice_header_size = 12;
+
+const boost::int64_t FiletimeOffset = 0x19DB1DED53E8000ll;
+
+struct fixture_options {
+	
+	const fixture_version * version;
+	
+	stream::compression_method compression;
+	
+	bool call_filter;
+	
+	size_t file_count;
+	boost::uint64_t min_size;
+	boost::uint64_t max_size;
+	
+	size_t files_per_chunk;
+	
+	size_t language_count;
+	
+	boost::uint64_t slice_size; // 0 to embed the data in the setup file
+	
+	unsigned seed;
+	
+};
+
+//! Buffer that serializes values the same way \ref util::load reads them.
+class writer {
+	
+	std::string & data;
+	
+public:
+	
+	explicit writer(std::string & target) : data(target) { }
+	
+	template <class T>
+	writer & store(T value) {
+		char buffer[sizeof(T)];
+		util::little_endian::store(value, buffer);
+		data.append(buffer, sizeof(buffer));
+		return *this;
+	}
+	
+	writer & raw(const char * buffer, size_t size) {
+		data.append(buffer, size);
+		return *this;
+	}
+	
+	writer & zeros(size_t size) {
+		data.append(size, '\0');
+		return *this;
+	}
+	
+	writer & binary_string(const std::string & str) {
+		store(boost::uint32_t(str.size()));
+		data.append(str);
+		return *this;
+	}
+	
+	//! Store an ASCII string as either Windows-1252 or UTF-16LE.
+	writer & encoded_string(const std::string & str, bool unicode) {
+		if(!unicode) {
+			return binary_string(str);
+		}
+		std::string utf16;
+		utf16.reserve(str.size() * 2);
+		BOOST_FOREACH(char c, str) {
+			utf16.push_back(c), utf16.push_back('\0');
+		}
+		return binary_string(utf16);
+	}
+	
+	writer & flags(size_t count) {
+		size_t bytes = (count + 7) / 8;
+		if(bytes == 3) {
+			bytes = 4; // 3-byte sets are padded to 4 bytes
+		}
+		return zeros(bytes);
+	}
+	
+	size_t size() const { return data.size(); }
+	
+};
+
+//! Simple deterministic PRNG so that fixtures are reproducible for a given seed.
+class random_source {
+	
+	boost::uint64_t state;
+	
+public:
+	
+	explicit random_source(unsigned seed) : state(boost::uint64_t(seed) * 2654435761u + 1) { }
+	
+	boost::uint32_t next() {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		return boost::uint32_t(state >> 33);
+	}
+	
+	boost::uint64_t range(boost::uint64_t min, boost::uint64_t max) {
+		if(max <= min) {
+			return min;
+		}
+		boost::uint64_t value = (boost::uint64_t(next()) << 32) | next();
+		return min + value % (max - min + 1);
+	}
+	
+};
+
+/*!
+ * Generate somewhat compressible file contents including x86 CALL/JMP opcodes
+ * so that the instruction filter has something to do.
+ */
+std::string make_contents(random_source & rng, boost::uint64_t size) {
+	
+	static const char * const words[] = {
+		"inno", "setup", "extract", "fixture", "data", "chunk", "slice", "file",
+	};
+	
+	std::string result;
+	result.reserve(size_t(size));
+	while(result.size() < size) {
+		boost::uint32_t r = rng.next();
+		switch(r % 4) {
+			case 0: {
+				result.push_back(char(0xe8 + (r >> 8) % 2));
+				boost::uint32_t addr = rng.next() % 0x10000;
+				if((r >> 9) % 2) {
+					addr = ~addr;
+				}
+				char buffer[4];
+				util::little_endian::store(addr, buffer);
+				result.append(buffer, 4);
+				break;
+			}
+			case 1: result.push_back(char(rng.next())); break;
+			default: result.append(words[(r >> 8) % boost::size(words)]); break;
+		}
+	}
+	result.resize(size_t(size));
+	
+	return result;
+}
+
+/*!
+ * Inverse of \ref stream::inno_exe_decoder_5200.
+ */
+std::string encode_call_instructions(const std::string & input, bool flip_high_byte) {
+	
+	static const size_t block_size = 0x10000;
+	
+	std::string result = input;
+	
+	size_t i = 0;
+	while(i < result.size()) {
+		
+		boost::uint8_t byte = boost::uint8_t(result[i++]);
+		if(byte != 0xe8 && byte != 0xe9) {
+			continue;
+		}
+		
+		const size_t block_size_left = block_size - ((i - 1) % block_size);
+		if(block_size_left < 5) {
+			continue;
+		}
+		
+		if(result.size() - i < 4) {
+			break;
+		}
+		
+		boost::uint8_t * buffer = reinterpret_cast<boost::uint8_t *>(&result[i]);
+		i += 4;
+		
+		if(buffer[3] != 0x00 && buffer[3] != 0xff) {
+			continue;
+		}
+		
+		boost::uint32_t addr = boost::uint32_t(i) & 0xffffff;
+		
+		boost::uint32_t rel = buffer[0] | (boost::uint32_t(buffer[1]) << 8)
+		                                | (boost::uint32_t(buffer[2]) << 16);
+		boost::uint32_t stored = rel + addr;
+		buffer[0] = boost::uint8_t(stored);
+		buffer[1] = boost::uint8_t(stored >> 8);
+		buffer[2] = boost::uint8_t(stored >> 16);
+		
+		if(flip_high_byte && (rel & 0x800000)) {
+			buffer[3] = boost::uint8_t(~buffer[3]);
+		}
+	}
+	
+	return result;
+}
+
+#if INNOEXTRACT_HAVE_LZMA
+
+std::string lzma_encode(const std::string & input, lzma_vli filter, lzma_options_lzma & options) {
+	
+	lzma_stream strm = LZMA_STREAM_INIT;
+	const lzma_filter filters[2] = { { filter,  &options }, { LZMA_VLI_UNKNOWN, NULL } };
+	if(lzma_raw_encoder(&strm, filters) != LZMA_OK) {
+		throw std::runtime_error("could not initialize lzma encoder");
+	}
+	
+	std::string result;
+	
+	strm.next_in = reinterpret_cast<const boost::uint8_t *>(input.data());
+	strm.avail_in = input.size();
+	
+	lzma_ret ret;
+	do {
+		boost::uint8_t buffer[8192];
+		strm.next_out = buffer;
+		strm.avail_out = sizeof(buffer);
+		ret = lzma_code(&strm, LZMA_FINISH);
+		result.append(reinterpret_cast<const char *>(buffer), sizeof(buffer) - strm.avail_out);
+	} while(ret == LZMA_OK);
+	
+	lzma_end(&strm);
+	
+	if(ret != LZMA_STREAM_END) {
+		throw std::runtime_error("lzma encoder error");
+	}
+	
+	return result;
+}
+
+//! Compress data in the format read by \ref stream::inno_lzma1_decompressor.
+std::string lzma1_compress(const std::string & input) {
+	
+	lzma_options_lzma options;
+	lzma_lzma_preset(&options, 6);
+	options.dict_size = 1 << 20;
+	
+	std::string result;
+	writer w(result);
+	w.store(boost::uint8_t((options.pb * 5 + options.lp) * 9 + options.lc));
+	w.store(boost::uint32_t(options.dict_size));
+	
+	return result + lzma_encode(input, LZMA_FILTER_LZMA1, options);
+}
+
+//! Compress data in the format read by \ref stream::inno_lzma2_decompressor.
+std::string lzma2_compress(const std::string & input) {
+	
+	lzma_options_lzma options;
+	lzma_lzma_preset(&options, 6);
+	
+	// Dictionary size 2^20 is encoded as property 16
+	options.dict_size = 1 << 20;
+	
+	return std::string(1, char(16)) + lzma_encode(input, LZMA_FILTER_LZMA2, options);
+}
+
+#else
+
+std::string lzma1_compress(const std::string & input) {
+	(void)input;
+	throw std::runtime_error("LZMA compression not supported by this build");
+}
+
+std::string lzma2_compress(const std::string & input) {
+	(void)input;
+	throw std::runtime_error("LZMA compression not supported by this build");
+}
+
+#endif // INNOEXTRACT_HAVE_LZMA
+
+template <class Compressor>
+std::string boost_compress(const std::string & input, const Compressor & compressor) {
+	std::string result;
+	io::filtering_ostream os;
+	os.push(compressor);
+	os.push(io::back_inserter(result));
+	os.write(input.data(), std::streamsize(input.size()));
+	os.reset();
+	return result;
+}
+
+std::string compress(const std::string & input, stream::compression_method method) {
+	switch(method) {
+		case stream::Stored: return input;
+		case stream::Zlib:   return boost_compress(input, io::zlib_compressor());
+		case stream::BZip2:  return boost_compress(input, io::bzip2_compressor());
+		case stream::LZMA1:  return lzma1_compress(input);
+		case stream::LZMA2:  return lzma2_compress(input);
+		default: throw std::runtime_error("unsupported compression");
+	}
+}
+
+/*!
+ * Wrap data in the block format read by \ref stream::block_reader:
+ * a CRC-protected header followed by LZMA1-compressed 4096-byte sub-blocks that are
+ * each preceded by their CRC32 checksum.
+ */
+std::string make_block(const std::string & data) {
+	
+	std::string compressed = lzma1_compress(data);
+	
+	std::string stored;
+	writer sw(stored);
+	for(size_t pos = 0; pos < compressed.size(); pos += 4096) {
+		size_t size = std::min(compressed.size() - pos, size_t(4096));
+		crypto::crc32 crc;
+		crc.init();
+		crc.update(compressed.data() + pos, size);
+		sw.store(crc.finalize());
+		sw.raw(compressed.data() + pos, size);
+	}
+	
+	std::string header;
+	writer hw(header);
+	hw.store(boost::uint32_t(stored.size()));
+	hw.store(boost::uint8_t(1)); // compressed
+	
+	crypto::crc32 crc;
+	crc.init();
+	crc.update(header.data(), header.size());
+	
+	std::string result;
+	writer w(result);
+	w.store(crc.finalize());
+	w.raw(header.data(), header.size());
+	w.raw(stored.data(), stored.size());
+	
+	return result;
+}
+
+struct file_info {
+	
+	std::string destination;
+	std::string languages;
+	
+	std::string contents;
+	
+	// Location of the file data
+	size_t chunk;
+	boost::uint64_t offset;
+	
+	char sha1[20];
+	
+	boost::int64_t timestamp;
+	
+};
+
+struct chunk_info {
+	
+	size_t first_slice;
+	size_t last_slice;
+	boost::uint32_t offset;
+	
+	std::string data; //!< compressed data, excluding the chunk magic
+	
+	bool compressed;
+	
+};
+
+size_t header_flag_count(const setup::version & version) {
+	size_t count = 43;
+	if(!version.unicode) {
+		count++; // ShowUndisplayableLanguages
+	}
+	if(version >= INNO_VERSION(5, 5, 0)) {
+		count += 3; // CloseApplications, RestartApplications, AllowNetworkDrive
+	}
+	return count;
+}
+
+void write_header(writer & w, const setup::version & v, const fixture_options & o) {
+	
+	bool u = v.unicode;
+	
+	w.encoded_string("Fixture", u); // app_name
+	w.encoded_string("Fixture 1.0", u); // app_versioned_name
+	w.encoded_string("fixture", u); // app_id
+	w.encoded_string("", u); // app_copyright
+	w.encoded_string("innoextract", u); // app_publisher
+	w.encoded_string("", u); // app_publisher_url
+	w.encoded_string("", u); // app_support_phone
+	w.encoded_string("", u); // app_support_url
+	w.encoded_string("", u); // app_updates_url
+	w.encoded_string("1.0", u); // app_version
+	w.encoded_string("{pf}\\Fixture", u); // default_dir_name
+	w.encoded_string("Fixture", u); // default_group_name
+	w.encoded_string("setup", u); // base_filename
+	w.encoded_string("{app}", u); // uninstall_files_dir
+	w.encoded_string("", u); // uninstall_name
+	w.encoded_string("", u); // uninstall_icon
+	w.encoded_string("", u); // app_mutex
+	w.encoded_string("", u); // default_user_name
+	w.encoded_string("", u); // default_user_organisation
+	w.encoded_string("", u); // default_serial
+	w.encoded_string("", u); // app_readme_file
+	w.encoded_string("", u); // app_contact
+	w.encoded_string("", u); // app_comments
+	w.encoded_string("", u); // app_modify_path
+	w.encoded_string("yes", u); // create_uninstall_registry_key
+	w.encoded_string("yes", u); // uninstallable
+	if(v >= INNO_VERSION(5, 5, 6)) {
+		w.encoded_string("", u); // setupmutex_filter
+	}
+	if(v >= INNO_VERSION(5, 5, 0)) {
+		w.encoded_string("", u); // close_applications_filter
+	}
+	w.binary_string(""); // license_text
+	w.binary_string(""); // info_before
+	w.binary_string(""); // info_after
+	w.binary_string(""); // compiled_code
+	
+	if(!u) {
+		w.zeros(256 / 8); // lead_bytes
+	}
+	
+	w.store(boost::uint32_t(0)); // language_count
+	w.store(boost::uint32_t(0)); // message_count
+	w.store(boost::uint32_t(0)); // permission_count
+	w.store(boost::uint32_t(0)); // type_count
+	w.store(boost::uint32_t(0)); // component_count
+	w.store(boost::uint32_t(0)); // task_count
+	w.store(boost::uint32_t(0)); // directory_count
+	w.store(boost::uint32_t(o.file_count)); // file_count
+	w.store(boost::uint32_t(o.file_count)); // data_entry_count
+	w.store(boost::uint32_t(0)); // icon_count
+	w.store(boost::uint32_t(0)); // ini_entry_count
+	w.store(boost::uint32_t(0)); // registry_entry_count
+	w.store(boost::uint32_t(0)); // delete_entry_count
+	w.store(boost::uint32_t(0)); // uninstall_delete_entry_count
+	w.store(boost::uint32_t(0)); // run_entry_count
+	w.store(boost::uint32_t(0)); // uninstall_run_entry_count
+	
+	w.zeros(20); // winver
+	
+	w.store(boost::uint32_t(0)); // back_color
+	w.store(boost::uint32_t(0)); // back_color2
+	w.store(boost::uint32_t(0)); // image_back_color
+	
+	w.zeros(20); // password (SHA-1)
+	w.zeros(8); // password_salt
+	
+	w.store(boost::int64_t(0)); // extra_disk_space_required
+	w.store(boost::uint32_t(1)); // slices_per_disk
+	
+	w.store(boost::uint8_t(0)); // uninstall_log_mode
+	w.store(boost::uint8_t(0)); // dir_exists_warning
+	w.store(boost::uint8_t(0)); // privileges_required
+	w.store(boost::uint8_t(0)); // show_language_dialog
+	w.store(boost::uint8_t(0)); // language_detection
+	
+	boost::uint8_t compression;
+	switch(o.compression) {
+		case stream::Stored: compression = 0; break;
+		case stream::Zlib:   compression = 1; break;
+		case stream::BZip2:  compression = 2; break;
+		case stream::LZMA1:  compression = 3; break;
+		case stream::LZMA2:  compression = 4; break;
+		default: throw std::runtime_error("unsupported compression");
+	}
+	w.store(compression);
+	
+	w.store(boost::uint8_t(1)); // architectures_allowed
+	w.store(boost::uint8_t(1)); // architectures_installed_in_64bit_mode
+	
+	w.store(boost::uint8_t(0)); // disable_dir_page
+	w.store(boost::uint8_t(0)); // disable_program_group_page
+	
+	if(v >= INNO_VERSION(5, 5, 0)) {
+		w.store(boost::uint64_t(0)); // uninstall_display_size
+	} else {
+		w.store(boost::uint32_t(0)); // uninstall_display_size
+	}
+	
+	w.flags(header_flag_count(v));
+}
+
+void write_file_entry(writer & w, const setup::version & v, const file_info & file,
+                      size_t index) {
+	
+	bool u = v.unicode;
+	
+	w.encoded_string("", u); // source
+	w.encoded_string(file.destination, u);
+	w.encoded_string("", u); // install_font_name
+	w.encoded_string("", u); // strong_assembly_name
+	
+	w.encoded_string("", u); // components
+	w.encoded_string("", u); // tasks
+	w.encoded_string(file.languages, u);
+	w.encoded_string("", u); // check
+	w.encoded_string("", u); // after_install
+	w.encoded_string("", u); // before_install
+	
+	w.zeros(20); // winver
+	
+	w.store(boost::uint32_t(index)); // location
+	w.store(boost::uint32_t(0)); // attributes
+	w.store(boost::uint64_t(file.contents.size())); // external_size
+	w.store(boost::int16_t(-1)); // permission
+	
+	w.flags(32);
+	
+	w.store(boost::uint8_t(0)); // type
+}
+
+void write_data_entry(writer & w, const file_info & file, const chunk_info & chunk,
+                      bool call_filter) {
+	
+	w.store(boost::uint32_t(chunk.first_slice));
+	w.store(boost::uint32_t(chunk.last_slice));
+	w.store(boost::uint32_t(chunk.offset));
+	w.store(boost::uint64_t(file.offset));
+	w.store(boost::uint64_t(file.contents.size()));
+	w.store(boost::uint64_t(chunk.data.size()));
+	w.raw(file.sha1, sizeof(file.sha1));
+	w.store(boost::int64_t(file.timestamp * 10000000 + FiletimeOffset));
+	w.store(boost::uint32_t(0)); // file_version_ms
+	w.store(boost::uint32_t(0)); // file_version_ls
+	
+	// VersionInfoValid, VersionInfoNotValid, TimeStampInUTC, IsUninstallerExe,
+	// CallInstructionOptimized, Touch, ChunkEncrypted, ChunkCompressed, SolidBreak
+	boost::uint16_t flags = 1 << 2;
+	if(call_filter) {
+		flags |= 1 << 4;
+	}
+	if(chunk.compressed) {
+		flags |= 1 << 7;
+	}
+	w.store(flags);
+}
+
+std::string version_string(const setup::version & v) {
+	std::ostringstream oss;
+	oss << "Inno Setup Setup Data (" << v.a() << '.' << v.b() << '.' << v.c() << ')';
+	if(v.unicode) {
+		oss << " (u)";
+	}
+	std::string result = oss.str();
+	result.resize(64, '\0');
+	return result;
+}
+
+void write_file(const fs::path & path, const std::string & data) {
+	util::ofstream ofs(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if(!ofs.is_open()) {
+		throw std::runtime_error("could not open output file \"" + path.string() + '"');
+	}
+	ofs.write(data.data(), std::streamsize(data.size()));
+	if(ofs.fail()) {
+		throw std::runtime_error("error writing file \"" + path.string() + '"');
+	}
+}
+
+void generate(const fs::path & output, const fixture_options & o) {
+	
+	setup::version v(o.version->version, o.version->unicode, true);
+	
+	random_source rng(o.seed);
+	
+	static const char * const languages[] = { "english", "german", "french", "spanish" };
+	
+	// Generate file contents
+	std::vector<file_info> files(o.file_count);
+	for(size_t i = 0; i < files.size(); i++) {
+		file_info & file = files[i];
+		std::ostringstream oss;
+		oss << "{app}\\dir" << (i % 7) << "\\sub" << (i % 3) << "\\file" << i << ".bin";
+		file.destination = oss.str();
+		if(o.language_count && i % 3 == 0) {
+			file.languages = languages[i % std::min(o.language_count, size_t(4))];
+		}
+		file.contents = make_contents(rng, rng.range(o.min_size, o.max_size));
+		crypto::sha1 sha1;
+		sha1.init();
+		sha1.update(file.contents.data(), file.contents.size());
+		sha1.finalize(file.sha1);
+		file.timestamp = 1262304000 + boost::int64_t(rng.range(0, 100000000));
+	}
+	
+	// Group files into chunks
+	std::vector<chunk_info> chunks;
+	size_t per_chunk = std::max(o.files_per_chunk, size_t(1));
+	for(size_t first = 0; first < files.size(); first += per_chunk) {
+		std::string raw;
+		size_t end = std::min(first + per_chunk, files.size());
+		for(size_t i = first; i < end; i++) {
+			files[i].chunk = chunks.size();
+			files[i].offset = raw.size();
+			if(o.call_filter) {
+				raw += encode_call_instructions(files[i].contents, true);
+			} else {
+				raw += files[i].contents;
+			}
+		}
+		chunk_info chunk;
+		chunk.compressed = (o.compression != stream::Stored);
+		chunk.data = compress(raw, o.compression);
+		chunks.push_back(chunk);
+	}
+	
+	// Lay out the chunks in slices
+	std::vector<std::string> slices(1);
+	if(o.slice_size) {
+		slices.back().resize(slice_header_size);
+	}
+	BOOST_FOREACH(chunk_info & chunk, chunks) {
+		std::string data = std::string(chunk_magic, sizeof(chunk_magic)) + chunk.data;
+		if(o.slice_size && slices.back().size() + sizeof(chunk_magic) > o.slice_size) {
+			slices.push_back(std::string(slice_header_size, '\0'));
+		}
+		chunk.first_slice = slices.size() - 1;
+		chunk.offset = boost::uint32_t(slices.back().size());
+		size_t pos = 0;
+		while(true) {
+			size_t size = data.size() - pos;
+			if(o.slice_size) {
+				size = std::min(size, size_t(o.slice_size - slices.back().size()));
+			}
+			slices.back().append(data, pos, size);
+			pos += size;
+			if(pos == data.size()) {
+				break;
+			}
+			slices.push_back(std::string(slice_header_size, '\0'));
+		}
+		chunk.last_slice = slices.size() - 1;
+	}
+	
+	// Serialize the headers
+	std::string primary;
+	writer pw(primary);
+	write_header(pw, v, o);
+	for(size_t i = 0; i < files.size(); i++) {
+		write_file_entry(pw, v, files[i], i);
+	}
+	pw.binary_string(""); // wizard_image
+	pw.binary_string(""); // wizard_image_small
+	if(o.compression == stream::BZip2 || o.compression == stream::Zlib) {
+		pw.binary_string(""); // decompressor_dll
+	}
+	
+	std::string secondary;
+	writer sw(secondary);
+	for(size_t i = 0; i < files.size(); i++) {
+		write_data_entry(sw, files[i], chunks[files[i].chunk], o.call_filter);
+	}
+	
+	std::string headers = version_string(v) + make_block(primary) + make_block(secondary);
+	
+	if(o.slice_size) {
+		
+		// Headers-only setup file with external slices
+		write_file(output, headers);
+		
+		std::string basename = output.stem().string();
+		for(size_t i = 0; i < slices.size(); i++) {
+			std::string & slice = slices[i];
+			std::memcpy(&slice[0], slice_magic, sizeof(slice_magic));
+			util::little_endian::store(boost::uint32_t(slice.size()), &slice[8]);
+			std::ostringstream oss;
+			oss << basename << '-' << (i + 1) << ".bin";
+			write_file(output.parent_path() / oss.str(), slice);
+		}
+		
+	} else {
+		
+		// Single file with a loader offset table, the headers and the data
+		std::string exe(0x200, '\0');
+		boost::uint32_t table_offset = 0x40;
+		boost::uint32_t header_offset = boost::uint32_t(exe.size());
+		boost::uint32_t data_offset = boost::uint32_t(header_offset + headers.size());
+		
+		std::string ptr;
+		writer(ptr).store(SetupLoaderHeaderMagic).store(table_offset).store(~table_offset);
+		exe.replace(SetupLoaderHeaderOffset, ptr.size(), ptr);
+		
+		std::string table;
+		writer tw(table);
+		tw.raw(reinterpret_cast<const char *>(setup_loader_magic), sizeof(setup_loader_magic));
+		tw.store(boost::uint32_t(1)); // revision
+		tw.store(boost::uint32_t(0));
+		tw.store(boost::uint32_t(0)); // exe_offset
+		tw.store(boost::uint32_t(0)); // exe_uncompressed_size
+		tw.store(boost::uint32_t(0)); // exe_checksum
+		tw.store(header_offset);
+		tw.store(data_offset);
+		crypto::crc32 crc;
+		crc.init();
+		crc.update(table.data(), table.size());
+		tw.store(crc.finalize());
+		exe.replace(table_offset, table.size(), table);
+		
+		write_file(output, exe + headers + slices.front());
+	}
+	
+	std::cout << "Wrote " << files.size() << " files in " << chunks.size() << " chunks and "
+	          << (o.slice_size ? slices.size() : 0) << " external slices to "
+	          << output.string() << " (setup data version " << v << ")\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char * argv[]) {
+	
+	po::options_description options_desc("Options");
+	options_desc.add_options()
+		("help,h", "Show supported options")
+		("output,o", po::value<std::string>(), "Setup file to create")
+		("data-version", po::value<std::string>()->default_value("5.5.0u"),
+		 "Setup data version: 5.3.10, 5.4.2, 5.5.0 or 5.5.6 with an optional 'u' suffix")
+		("compression", po::value<std::string>()->default_value("lzma2"),
+		 "Chunk compression: stored, zlib, bzip2, lzma1 or lzma2")
+		("call-filter", "Apply the call instruction filter to file data")
+		("files", po::value<size_t>()->default_value(100), "Number of files")
+		("min-size", po::value<boost::uint64_t>()->default_value(0), "Minimum file size")
+		("max-size", po::value<boost::uint64_t>()->default_value(65536), "Maximum file size")
+		("files-per-chunk", po::value<size_t>()->default_value(16),
+		 "Number of files in each solid chunk")
+		("languages", po::value<size_t>()->default_value(0),
+		 "Number of languages to assign to some of the files (up to 4)")
+		("slice-size", po::value<boost::uint64_t>()->default_value(0),
+		 "Maximum size of external slice files, or 0 to embed the data")
+		("seed", po::value<unsigned>()->default_value(1), "Seed for generated contents")
+	;
+	
+	po::variables_map options;
+	try {
+		po::store(po::parse_command_line(argc, argv, options_desc), options);
+		po::notify(options);
+	} catch(po::error & e) {
+		std::cerr << "Error parsing command-line: " << e.what() << "\n\n" << options_desc;
+		return ExitUserError;
+	}
+	
+	if(options.count("help") || !options.count("output")) {
+		std::cout << "Usage: " << argv[0] << " --output <setup file> [options]\n\n";
+		std::cout << "Generate a synthetic Inno Setup installer.\n";
+		std::cout << options_desc << '\n';
+		return options.count("help") ? ExitSuccess : ExitUserError;
+	}
+	
+	fixture_options o;
+	
+	o.version = NULL;
+	std::string version = options["data-version"].as<std::string>();
+	for(size_t i = 0; i < size_t(boost::size(fixture_versions)); i++) {
+		if(version == fixture_versions[i].name) {
+			o.version = &fixture_versions[i];
+		}
+	}
+	if(!o.version) {
+		std::cerr << "Unsupported setup data version: " << version << '\n';
+		return ExitUserError;
+	}
+	
+	std::string compression = options["compression"].as<std::string>();
+	if(boost::iequals(compression, "stored")) {
+		o.compression = stream::Stored;
+	} else if(boost::iequals(compression, "zlib")) {
+		o.compression = stream::Zlib;
+	} else if(boost::iequals(compression, "bzip2")) {
+		o.compression = stream::BZip2;
+	} else if(boost::iequals(compression, "lzma1")) {
+		o.compression = stream::LZMA1;
+	} else if(boost::iequals(compression, "lzma2")) {
+		o.compression = stream::LZMA2;
+	} else {
+		std::cerr << "Unsupported compression: " << compression << '\n';
+		return ExitUserError;
+	}
+	
+	o.call_filter = (options.count("call-filter") != 0);
+	o.file_count = options["files"].as<size_t>();
+	o.min_size = options["min-size"].as<boost::uint64_t>();
+	o.max_size = options["max-size"].as<boost::uint64_t>();
+	o.files_per_chunk = options["files-per-chunk"].as<size_t>();
+	o.language_count = options["languages"].as<size_t>();
+	o.slice_size = options["slice-size"].as<boost::uint64_t>();
+	o.seed = options["seed"].as<unsigned>();
+	
+	if(o.slice_size && o.slice_size <= slice_header_size + sizeof(chunk_magic)) {
+		std::cerr << "Slice size too small\n";
+		return ExitUserError;
+	}
+	
+	try {
+		generate(options["output"].as<std::string>(), o);
+	} catch(const std::exception & e) {
+		std::cerr << "Error: " << e.what() << '\n';
+		return ExitDataError;
+	}
+	
+	return ExitSuccess;
+}
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2014 Daniel Scharrer
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the author(s) be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*!
+ * \file
+ *
+ * Tool to mount the contents of a setup file as a read-only FUSE filesystem.
+ */
+
+#define FUSE_USE_VERSION 26
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <fuse.h>
+
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include "loader/cache.hpp"
+#include "loader/installer.hpp"
+
+#include "setup/data.hpp"
+#include "setup/file.hpp"
+#include "setup/filename.hpp"
+#include "setup/version.hpp"
+
+#include "util/console.hpp"
+#include "util/log.hpp"
+#include "util/time.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+//! A file or directory in the mounted tree.
+struct node {
+	
+	bool directory;
+	
+	size_t file_index;     //!< Index into \ref setup::info::files for files.
+	boost::uint64_t size;
+	util::time mtime;
+	
+	std::vector<std::string> children; //!< Names of the entries in a directory.
+	
+	node() : directory(true), file_index(0), size(0), mtime(0) { }
+	
+};
+
+typedef boost::unordered_map<std::string, node> node_map;
+
+node_map nodes; //!< All files and directories, indexed by their absolute path.
+
+boost::scoped_ptr<loader::installer> installer;
+boost::scoped_ptr<loader::cached_reader> reader;
+
+//! Add a directory and its parents to the tree.
+node * add_directory(const std::string & path, util::time mtime) {
+	
+	node_map::iterator i = nodes.find(path);
+	if(i != nodes.end()) {
+		return i->second.directory ? &i->second : NULL;
+	}
+	
+	size_t sep = path.find_last_of('/');
+	node * parent = add_directory(path.substr(0, sep == 0 ? 1 : sep), mtime);
+	if(!parent) {
+		return NULL;
+	}
+	parent->children.push_back(path.substr(sep + 1));
+	
+	node & dir = nodes[path];
+	dir.mtime = mtime;
+	return &dir;
+}
+
+void build_tree(util::time mtime) {
+	
+	setup::filename_map filenames;
+	filenames.set_expand(true);
+	
+	nodes["/"].mtime = mtime;
+	
+	const setup::info & info = installer->info;
+	for(size_t i = 0; i < info.files.size(); i++) {
+		
+		const setup::file_entry & file = info.files[i];
+		if(file.location >= info.data_entries.size() || file.destination.empty()) {
+			continue;
+		}
+		const setup::data_entry & data = info.data_entries[file.location];
+		
+		std::string path = filenames.convert(file.destination);
+		if(path.empty()) {
+			continue;
+		}
+		path = '/' + path;
+		
+		size_t sep = path.find_last_of('/');
+		node * parent = add_directory(path.substr(0, sep == 0 ? 1 : sep), mtime);
+		node_map::iterator existing = nodes.find(path);
+		if(!parent || (existing != nodes.end() && existing->second.directory)) {
+			log_warning << "Skipping \"" << path << "\": conflicting path";
+			continue;
+		}
+		
+		// Files listed multiple times (e.g. for different languages): the last one wins
+		if(existing == nodes.end()) {
+			parent->children.push_back(path.substr(sep + 1));
+		}
+		
+		node & entry = nodes[path];
+		entry.directory = false;
+		entry.file_index = i;
+		entry.size = data.file.size;
+		entry.mtime = data.timestamp;
+	}
+}
+
+const node * find(const char * path) {
+	node_map::const_iterator i = nodes.find(path);
+	return (i == nodes.end()) ? NULL : &i->second;
+}
+
+int mount_getattr(const char * path, struct stat * st) {
+	
+	const node * entry = find(path);
+	if(!entry) {
+		return -ENOENT;
+	}
+	
+	memset(st, 0, sizeof(*st));
+	if(entry->directory) {
+		st->st_mode = S_IFDIR | 0555;
+		st->st_nlink = 2;
+	} else {
+		st->st_mode = S_IFREG | 0444;
+		st->st_nlink = 1;
+		st->st_size = off_t(entry->size);
+	}
+	st->st_mtime = time_t(entry->mtime);
+	st->st_atime = st->st_ctime = st->st_mtime;
+	
+	return 0;
+}
+
+int mount_readdir(const char * path, void * buffer, fuse_fill_dir_t filler, off_t offset,
+                  struct fuse_file_info * fi) {
+	
+	(void)offset, (void)fi;
+	
+	const node * entry = find(path);
+	if(!entry) {
+		return -ENOENT;
+	} else if(!entry->directory) {
+		return -ENOTDIR;
+	}
+	
+	filler(buffer, ".", NULL, 0);
+	filler(buffer, "..", NULL, 0);
+	BOOST_FOREACH(const std::string & name, entry->children) {
+		filler(buffer, name.c_str(), NULL, 0);
+	}
+	
+	return 0;
+}
+
+int mount_open(const char * path, struct fuse_file_info * fi) {
+	
+	const node * entry = find(path);
+	if(!entry) {
+		return -ENOENT;
+	} else if(entry->directory) {
+		return -EISDIR;
+	}
+	
+	if((fi->flags & O_ACCMODE) != O_RDONLY) {
+		return -EROFS;
+	}
+	
+	fi->fh = entry->file_index;
+	
+	return 0;
+}
+
+int mount_read(const char * path, char * buffer, size_t size, off_t offset,
+               struct fuse_file_info * fi) {
+	
+	try {
+		return int(reader->read(size_t(fi->fh), boost::uint64_t(offset), buffer, size));
+	} catch(const std::exception & e) {
+		log_error << "Error reading \"" << path << "\": " << e.what();
+		return -EIO;
+	}
+}
+
+/*!
+ * Parse a size with an optional K, M or G suffix.
+ *
+ * \return the size in bytes or \c 0 if the size is invalid.
+ */
+boost::uint64_t parse_size(const std::string & value) {
+	
+	char * end;
+	boost::uint64_t size = boost::uint64_t(strtoull(value.c_str(), &end, 10));
+	if(end == value.c_str()) {
+		return 0;
+	}
+	
+	switch(*end) {
+		case '\0': return size;
+		case 'k': case 'K': size <<= 10; break;
+		case 'm': case 'M': size <<= 20; break;
+		case 'g': case 'G': size <<= 30; break;
+		default: return 0;
+	}
+	
+	return (end[1] == '\0') ? size : 0;
+}
+
+} // anonymous namespace
+
+int main(int argc, char * argv[]) {
+	
+	// Options for this tool must come before the setup file
+	boost::uint64_t max_memory = 0;
+	int first = 1;
+	for(; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+		std::string option = argv[first];
+		const std::string max_memory_option = "--max-memory=";
+		if(option.compare(0, max_memory_option.size(), max_memory_option) == 0) {
+			max_memory = parse_size(option.substr(max_memory_option.size()));
+			if(!max_memory) {
+				std::cerr << "Invalid memory limit: " << option << '\n';
+				return 1;
+			}
+		} else {
+			std::cerr << "Unknown option: " << option << '\n';
+			return 1;
+		}
+	}
+	
+	if(argc - first < 2) {
+		std::cerr << "Usage: " << argv[0]
+		          << " [--max-memory=SIZE] <setup file> <mountpoint> [FUSE options]\n";
+		return 1;
+	}
+	fs::path file = argv[first];
+	
+	color::init(color::automatic, color::disable);
+	logger::quiet = true;
+	
+	try {
+		installer.reset(new loader::installer(file));
+	} catch(const setup::version_error &) {
+		log_error << "Not a supported Inno Setup installer!";
+		return 1;
+	} catch(const std::exception & e) {
+		log_error << e.what();
+		return 1;
+	}
+	
+	reader.reset(new loader::cached_reader(*installer, 64 * 1024 * 1024, 4, max_memory));
+	
+	util::time mtime = 0;
+	try {
+		mtime = util::time(fs::last_write_time(file));
+	} catch(...) {
+		// Use 0 for directories
+	}
+	build_tree(mtime);
+	
+	struct fuse_operations operations;
+	memset(&operations, 0, sizeof(operations));
+	operations.getattr = mount_getattr;
+	operations.readdir = mount_readdir;
+	operations.open = mount_open;
+	operations.read = mount_read;
+	
+	// Pass everything except the setup file on to FUSE
+	std::vector<char *> args;
+	args.push_back(argv[0]);
+	args.insert(args.end(), argv + first + 1, argv + argc);
+	args.push_back(const_cast<char *>("-oro"));
+	args.push_back(NULL);
+	
+	return fuse_main(int(args.size() - 1), &args.front(), &operations, NULL);
+}
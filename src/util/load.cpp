@@ -21,6 +21,7 @@
 #include "util/load.hpp"
 
 #include <algorithm>
+#include <ios>
 
 #include <boost/lexical_cast.hpp>
 
@@ -58,6 +59,57 @@ void encoded_string::load(std::istream & is, std::string & target, codepage_id c
 	to_utf8(binary_string::load(is), target, codepage);
 }
 
+void span_reader::throw_end_of_data() {
+	throw std::ios_base::failure("unexpected end of data");
+}
+
+span_reader::span_reader(std::istream & is, std::string & data)
+	: pos(NULL), end(NULL), source(&is), buffer(&data) {
+	buffer->clear();
+	pos = end = buffer->data();
+}
+
+bool span_reader::fill(size_t count) {
+	
+	if(!source) {
+		return false;
+	}
+	
+	size_t offset = size_t(pos - buffer->data());
+	size_t size = buffer->size();
+	
+	// Read in large steps to avoid frequent small reads from the source stream, but never
+	// allocate much more than the stream actually contains - a corrupt length should not
+	// cause huge allocations.
+	size_t step = 64 * 1024;
+	
+	while(buffer->size() < size + count && source->good()) {
+		size_t old_size = buffer->size();
+		buffer->resize(old_size + step);
+		source->read(&(*buffer)[old_size], std::streamsize(step));
+		buffer->resize(old_size + size_t(source->gcount()));
+		step *= 2;
+	}
+	
+	pos = buffer->data() + offset;
+	end = buffer->data() + buffer->size();
+	
+	return buffer->size() >= size + count;
+}
+
+void binary_string::load(span_reader & is, std::string & target) {
+	boost::uint32_t length = util::load<boost::uint32_t>(is);
+	target.assign(is.take(length), length);
+}
+
+void binary_string::skip(span_reader & is) {
+	is.skip(util::load<boost::uint32_t>(is));
+}
+
+void encoded_string::load(span_reader & is, std::string & target, codepage_id codepage) {
+	to_utf8(binary_string::load(is), target, codepage);
+}
+
 unsigned to_unsigned(const char * chars, size_t count) {
 #if BOOST_VERSION < 105200
 	return boost::lexical_cast<unsigned>(std::string(chars, count));
@@ -39,6 +39,90 @@
 
 namespace util {
 
+/*!
+ * Bounds-checked cursor over an in-memory buffer.
+ *
+ * This supports the same \ref load, \ref binary_string and \ref encoded_string
+ * interface as std::istream, but without constructing a stream sentry and checking the
+ * stream state for every value. Use it to parse data that has already been fully
+ * decompressed into memory.
+ *
+ * Reading past the end of the buffer throws a std::ios_base::failure.
+ *
+ * The buffer is not copied and must stay valid while the cursor is used.
+ *
+ * Alternatively, the cursor can pull data from an input stream into a growing buffer
+ * as it is needed. This allows to stop reading (and decompressing) a stream as soon as
+ * all interesting data has been parsed.
+ */
+class span_reader {
+	
+	const char * pos;
+	const char * end;
+	
+	std::istream * source; //!< Stream to read more data from, or \c NULL.
+	std::string * buffer;  //!< Buffer holding all data read from \ref source.
+	
+	static void throw_end_of_data();
+	
+	/*!
+	 * Read at least \c count more bytes from the source stream into the buffer.
+	 *
+	 * \return false if the source stream ended before that.
+	 */
+	bool fill(size_t count);
+	
+public:
+	
+	span_reader(const char * data, size_t size)
+		: pos(data), end(data + size), source(NULL), buffer(NULL) { }
+	
+	explicit span_reader(const std::string & data)
+		: pos(data.data()), end(data.data() + data.size()), source(NULL), buffer(NULL) { }
+	
+	/*!
+	 * Read data from a stream on demand.
+	 *
+	 * \param source The stream to read from. Reading must not throw at the end of the
+	 *               stream.
+	 * \param buffer Buffer to collect the data read so far. Its existing contents are
+	 *               discarded.
+	 */
+	span_reader(std::istream & source, std::string & buffer);
+	
+	/*!
+	 * Consume a number of bytes.
+	 *
+	 * \return a pointer to the consumed bytes in the underlying buffer.
+	 *         For stream-backed cursors the pointer is only valid until the next call.
+	 */
+	const char * take(size_t count) {
+		if(count > size_t(end - pos) && !fill(count - size_t(end - pos))) {
+			throw_end_of_data();
+		}
+		const char * data = pos;
+		pos += count;
+		return data;
+	}
+	
+	//! Copy the next \c count bytes to \c buffer.
+	void read(char * buffer, size_t count) {
+		std::memcpy(buffer, take(count), count);
+	}
+	
+	//! Skip the next \c count bytes.
+	void skip(size_t count) {
+		(void)take(count);
+	}
+	
+	//! \return the number of bytes left in the buffer, not including unread stream data.
+	size_t remaining() const { return size_t(end - pos); }
+	
+	//! \return true if all bytes have been consumed.
+	bool eof() { return pos == end && !fill(1); }
+	
+};
+
 /*!
  * Wrapper to load a length-prefixed string from an input stream into a std::string.
  * The string length is stored as 32-bit integer.
@@ -68,11 +152,27 @@ struct binary_string {
 		return target;
 	}
 	
+	//! Load a length-prefixed string
+	static void load(span_reader & is, std::string & target);
+	
+	static void skip(span_reader & is);
+	
+	//! Load a length-prefixed string
+	static std::string load(span_reader & is) {
+		std::string target;
+		load(is, target);
+		return target;
+	}
+	
 };
 inline std::istream & operator>>(std::istream & is, const binary_string & str) {
 	binary_string::load(is, str.data);
 	return is;
 }
+inline span_reader & operator>>(span_reader & is, const binary_string & str) {
+	binary_string::load(is, str.data);
+	return is;
+}
 
 /*!
  * Wrapper to load a length-prefixed string with a specified encoding from an input stream
@@ -115,11 +215,33 @@ struct encoded_string {
 		return target;
 	}
 	
+	/*!
+	 * Load and convert a length-prefixed string
+	 *
+	 * \note This function is not thread-safe.
+	 */
+	static void load(span_reader & is, std::string & target, codepage_id codepage);
+	
+	/*!
+	 * Load and convert a length-prefixed string
+	 *
+	 * \note This function is not thread-safe.
+	 */
+	static std::string load(span_reader & is, codepage_id codepage) {
+		std::string target;
+		load(is, target, codepage);
+		return target;
+	}
+	
 };
 inline std::istream & operator>>(std::istream & is, const encoded_string & str) {
 	encoded_string::load(is, str.data, str.codepage);
 	return is;
 }
+inline span_reader & operator>>(span_reader & is, const encoded_string & str) {
+	encoded_string::load(is, str.data, str.codepage);
+	return is;
+}
 
 /*!
  * Convenience specialization of \ref encoded_string for loading Windows-1252 strings
@@ -143,18 +265,31 @@ T load(std::istream & is) {
 template <class T>
 T load(std::istream & is) { return load<T, little_endian>(is); }
 
+//! Load a value of type T that is stored with a specific endianness.
+template <class T, class Endianness>
+T load(span_reader & is) {
+	return Endianness::template load<T>(is.take(sizeof(T)));
+}
+//! Load a value of type T that is stored as little endian.
+template <class T>
+T load(span_reader & is) { return load<T, little_endian>(is); }
+
 //! Load a bool value
 inline bool load_bool(std::istream & is) {
 	return !!load<boost::uint8_t>(is);
 }
+//! Load a bool value
+inline bool load_bool(span_reader & is) {
+	return !!load<boost::uint8_t>(is);
+}
 
 /*!
  * Load a value of type T that is stored with a specific endianness.
- * \param is   Input stream to load from.
+ * \param is   Input stream or \ref span_reader to load from.
  * \param bits The number of bits used to store the number.
  */
-template <class T, class Endianness>
-T load(std::istream & is, size_t bits) {
+template <class T, class Endianness, class Stream>
+T load(Stream & is, size_t bits) {
 	if(bits == 8) {
 		return load<typename compatible_integer<T, 8>::type, Endianness>(is);
 	} else if(bits == 16) {
@@ -167,11 +302,11 @@ T load(std::istream & is, size_t bits) {
 }
 /*!
  * Load a value of type T that is stored as little endian.
- * \param is   Input stream to load from.
+ * \param is   Input stream or \ref span_reader to load from.
  * \param bits The number of bits used to store the number.
  */
-template <class T>
-T load(std::istream & is, size_t bits) { return load<T, little_endian>(is, bits); }
+template <class T, class Stream>
+T load(Stream & is, size_t bits) { return load<T, little_endian>(is, bits); }
 
 /*!
  * Discard a number of bytes from a non-seekable input stream or stream-like object
@@ -20,7 +20,16 @@
 
 #include "util/log.hpp"
 
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "util/console.hpp"
 
@@ -30,24 +39,295 @@ bool logger::quiet = false;
 size_t logger::total_errors = 0;
 size_t logger::total_warnings = 0;
 
-logger::~logger() {
+namespace {
+
+logger::sink * log_sink = NULL;
+logger::output_format log_format = logger::Text;
+
+//! Remove ANSI escape sequences inserted by \ref color::shell_command.
+std::string strip_colors(const std::string & message) {
+	
+	std::string result;
+	result.reserve(message.size());
+	
+	for(size_t i = 0; i < message.size(); i++) {
+		if(message[i] == '\x1b' && i + 1 < message.size() && message[i + 1] == '[') {
+			i = message.find('m', i);
+			if(i == std::string::npos) {
+				break;
+			}
+		} else {
+			result.push_back(message[i]);
+		}
+	}
+	
+	return result;
+}
+
+std::string json_escape(const std::string & str) {
+	
+	std::string result;
+	result.reserve(str.size());
+	
+	for(size_t i = 0; i < str.size(); i++) {
+		unsigned char c = static_cast<unsigned char>(str[i]);
+		if(c == '"' || c == '\\') {
+			result.push_back('\\'), result.push_back(char(c));
+		} else if(c == '\n') {
+			result.append("\\n");
+		} else if(c == '\t') {
+			result.append("\\t");
+		} else if(c < 0x20) {
+			char buffer[7];
+			std::sprintf(buffer, "\\u%04x", unsigned(c));
+			result.append(buffer);
+		} else {
+			result.push_back(char(c));
+		}
+	}
+	
+	return result;
+}
+
+const char * level_name(logger::log_level level) {
+	switch(level) {
+		case logger::Debug:   return "debug";
+		case logger::Info:    return "info";
+		case logger::Warning: return "warning";
+		case logger::Error:   return "error";
+	}
+	return "unknown";
+}
+
+//! Write a message to the current output.
+void output(logger::log_level level, const std::string & message, size_t repeated) {
+	
+	if(log_sink) {
+		if(repeated) {
+			std::ostringstream oss;
+			oss << "last message repeated " << repeated << " more times";
+			log_sink->write(level, oss.str());
+		} else {
+			log_sink->write(level, strip_colors(message));
+		}
+		return;
+	}
+	
+	if(log_format == logger::JSON) {
+		std::cerr << "{\"level\":\"" << level_name(level) << "\",\"message\":\""
+		          << json_escape(strip_colors(message)) << '"';
+		if(repeated) {
+			std::cerr << ",\"repeated\":" << repeated;
+		}
+		std::cerr << "}\n";
+		return;
+	}
 	
 	color::shell_command previous = color::current;
 	progress::clear();
 	
+	std::ostringstream oss;
+	if(repeated) {
+		oss << "last message repeated " << repeated << " more times";
+	}
+	const std::string & text = repeated ? oss.str() : message;
+	
 	switch(level) {
-		case Debug:   std::cout << color::cyan   << buffer.str() << previous << "\n"; break;
-		case Info:    std::cout << color::white  << buffer.str() << previous << "\n"; break;
-		case Warning: {
-			std::cerr << color::yellow << "warning: " << buffer.str() << previous << "\n";
-			total_warnings++;
+		case logger::Debug: std::cout << color::cyan  << text << previous << "\n"; break;
+		case logger::Info:  std::cout << color::white << text << previous << "\n"; break;
+		case logger::Warning: {
+			std::cerr << color::yellow << "warning: " << text << previous << "\n";
 			break;
 		}
-		case Error: {
-			std::cerr << color::red << buffer.str() << previous << "\n";
-			total_errors++;
-			break;
+		case logger::Error: std::cerr << color::red << text << previous << "\n"; break;
+	}
+}
+
+/*!
+ * Collapse runs of identical messages.
+ *
+ * Only the first message of a run is written immediately, the number of repetitions
+ * is written when the run ends.
+ */
+class repeat_filter {
+	
+	bool active;
+	logger::log_level level;
+	std::string message;
+	size_t repeated;
+	
+public:
+	
+	repeat_filter() : active(false), level(logger::Debug), repeated(0) { }
+	
+	void write(logger::log_level new_level, const std::string & new_message) {
+		
+		if(active && new_level == level && new_message == message) {
+			repeated++;
+			return;
+		}
+		
+		finish();
+		
+		active = true, level = new_level, message = new_message;
+		output(level, message, 0);
+	}
+	
+	//! End the current run of messages.
+	void finish() {
+		if(repeated) {
+			output(level, message, repeated);
+		}
+		active = false, repeated = 0;
+	}
+	
+};
+
+/*!
+ * Shared logging state.
+ *
+ * This is allocated once and never freed so that the writer thread can still safely
+ * use it while static objects are destroyed at exit.
+ */
+struct log_state {
+	
+	//! Serializes all output and protects \ref repeats.
+	boost::mutex output_mutex;
+	repeat_filter repeats;
+	
+	//! Protects the members below.
+	boost::mutex queue_mutex;
+	boost::condition_variable queue_changed;
+	
+	struct queued_message {
+		
+		logger::log_level level;
+		std::string message;
+		bool flush; //!< Only end the current run of repeated messages.
+		
+		queued_message(logger::log_level level, const std::string & message, bool flush)
+			: level(level), message(message), flush(flush) { }
+		
+	};
+	
+	std::vector<queued_message> queue;
+	bool writer_started;
+	bool writer_busy;
+	
+	log_state() : writer_started(false), writer_busy(false) { }
+	
+	void write_queued() {
+		
+		std::vector<queued_message> messages;
+		
+		for(;;) {
+			
+			{
+				boost::mutex::scoped_lock lock(queue_mutex);
+				writer_busy = false;
+				queue_changed.notify_all();
+				while(queue.empty()) {
+					queue_changed.wait(lock);
+				}
+				messages.swap(queue);
+				writer_busy = true;
+			}
+			
+			boost::mutex::scoped_lock lock(output_mutex);
+			BOOST_FOREACH(const queued_message & message, messages) {
+				if(message.flush) {
+					repeats.finish();
+				} else {
+					repeats.write(message.level, message.message);
+				}
+			}
+			std::cerr.flush();
+			messages.clear();
+		}
+	}
+	
+	void enqueue(logger::log_level level, const std::string & message, bool flush) {
+		
+		boost::mutex::scoped_lock lock(queue_mutex);
+		
+		if(!writer_started) {
+			boost::thread writer(&log_state::write_queued, this);
+			writer.detach();
+			writer_started = true;
+		}
+		
+		queue.push_back(queued_message(level, message, flush));
+		queue_changed.notify_all();
+	}
+	
+	void flush() {
+		
+		{
+			boost::mutex::scoped_lock lock(queue_mutex);
+			if(writer_started) {
+				queue.push_back(queued_message(logger::Debug, std::string(), true));
+				queue_changed.notify_all();
+				while(!queue.empty() || writer_busy) {
+					queue_changed.wait(lock);
+				}
+			}
+		}
+		
+		boost::mutex::scoped_lock lock(output_mutex);
+		repeats.finish();
+	}
+	
+};
+
+log_state * state;
+boost::once_flag state_once = BOOST_ONCE_INIT;
+
+void flush_at_exit() {
+	state->flush();
+}
+
+void init_state() {
+	state = new log_state;
+	std::atexit(flush_at_exit);
+}
+
+log_state & get_state() {
+	boost::call_once(state_once, init_state);
+	return *state;
+}
+
+} // anonymous namespace
+
+void logger::set_sink(sink * output) {
+	flush();
+	log_sink = output;
+}
+
+void logger::set_format(output_format format) {
+	flush();
+	log_format = format;
+}
+
+void logger::flush() {
+	get_state().flush();
+}
+
+logger::~logger() {
+	
+	log_state & s = get_state();
+	
+	if(log_sink || log_format != Text) {
+		if(!log_sink) {
+			boost::mutex::scoped_lock lock(s.queue_mutex);
+			total_warnings += (level == Warning), total_errors += (level == Error);
 		}
+		s.enqueue(level, buffer.str(), false);
+		return;
 	}
 	
+	boost::mutex::scoped_lock lock(s.output_mutex);
+	
+	total_warnings += (level == Warning), total_errors += (level == Error);
+	
+	s.repeats.write(level, buffer.str());
 }
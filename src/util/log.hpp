@@ -45,6 +45,13 @@
 
 /*!
  * logger class that allows longging via the stream operator.
+ *
+ * Log messages can be created from any thread. Consecutive identical messages are
+ * only written once, followed by a summary with the number of repetitions.
+ *
+ * Console output in the default text format is written immediately so that it is
+ * correctly ordered with other output. Messages for a \ref sink or in the JSON
+ * format are handed off to a single writer thread - call \ref flush() to wait for them.
  */
 class logger {
 	
@@ -65,12 +72,59 @@ private:
 	
 public:
 	
+	//! Formats for log messages written to the console.
+	enum output_format {
+		Text, //!< Colored text, info and debug messages on stdout, everything else on stderr
+		JSON  //!< One JSON object per message and line on stderr
+	};
+	
 	static size_t total_warnings; //! Total number of \ref log_warning uses so far.
 	static size_t total_errors;   //! Total number of \ref log_error uses so far.
 	
 	static bool debug; //! Is \ref debug output enabled?
 	static bool quiet; //! Is \ref log_info disabled?
 	
+	//! Receiver for log messages that should not be written to the console.
+	class sink {
+		
+	public:
+		
+		/*!
+		 * Handle a single log message.
+		 *
+		 * \param level   The level of the message.
+		 * \param message The message text without color codes or a trailing newline.
+		 */
+		virtual void write(log_level level, const std::string & message) = 0;
+		
+		virtual ~sink() { }
+		
+	};
+	
+	/*!
+	 * Send all log messages to a sink instead of the console.
+	 *
+	 * While a sink is installed, the progress bar is left alone and messages are not
+	 * counted in \ref total_warnings and \ref total_errors.
+	 *
+	 * The sink is global and receives the messages from all threads.
+	 *
+	 * \param output The sink to use or \c NULL to restore console output.
+	 *               The sink must stay valid until it is replaced.
+	 */
+	static void set_sink(sink * output);
+	
+	//! Select the format for log messages written to the console.
+	static void set_format(output_format format);
+	
+	/*!
+	 * Write all pending log messages, including the summary for suppressed repetitions.
+	 *
+	 * This is done automatically at exit, but should also be called before writing
+	 * anything that needs to appear after all log messages so far.
+	 */
+	static void flush();
+	
 	/*!
 	 * Construct a log line output stream.
 	 *
@@ -74,7 +74,7 @@ public:
 	
 	static const size_t size = Mapping::count;
 	
-	explicit stored_enum(std::istream & is) {
+	explicit stored_enum(util::span_reader & is) {
 		BOOST_STATIC_ASSERT(size <= (1 << 8));
 		value = util::load<boost::uint8_t>(is);
 	}
@@ -110,7 +110,7 @@ public:
 	
 	static const size_t size = Bits;
 	
-	explicit stored_bitfield(std::istream & is) {
+	explicit stored_bitfield(util::span_reader & is) {
 		for(size_t i = 0; i < count; i++) {
 			bits[i] = util::load<base_type>(is);
 		}
@@ -162,7 +162,7 @@ public:
 	typedef typename Mapping::enum_type enum_type;
 	typedef flags<enum_type> flag_type;
 	
-	explicit stored_flags(std::istream & is)
+	explicit stored_flags(util::span_reader & is)
 		: stored_bitfield<Mapping::count, PadBits>(is) { }
 	
 	flag_type get() {
@@ -204,7 +204,7 @@ private:
 	
 	const size_t pad_bits;
 	
-	std::istream & is;
+	util::span_reader & is;
 	
 	typedef boost::uint8_t stored_type;
 	static const size_t stored_bits = sizeof(stored_type) * 8;
@@ -218,7 +218,7 @@ private:
 	
 public:
 	
-	explicit stored_flag_reader(std::istream & _is, size_t pad_bits = 32)
+	explicit stored_flag_reader(util::span_reader & _is, size_t pad_bits = 32)
 		: pad_bits(pad_bits), is(_is), pos(0), result(0), bytes(0) { }
 	
 	//! Declare the next possible flag.
@@ -251,11 +251,68 @@ class stored_flag_reader<flags<Enum> > : public stored_flag_reader<Enum> {
 	
 public:
 	
-	explicit stored_flag_reader(std::istream & is, size_t pad_bits = 32)
+	explicit stored_flag_reader(util::span_reader & is, size_t pad_bits = 32)
 		: stored_flag_reader<Enum>(is, pad_bits) { }
 	
 };
 
+/*!
+ * Precomputed mapping for a flag set where the possible flags are not known at
+ * compile-time.
+ *
+ * This is equivalent to \ref stored_flag_reader, but the flags are only declared once
+ * and the mapping can then be used to load any number of entries with the same layout.
+ *
+ * \tparam Flags The \ref flags type to load.
+ */
+template <class Flags>
+class stored_flag_map {
+	
+public:
+	
+	typedef typename Flags::enum_type enum_type;
+	typedef Flags flag_type;
+	
+private:
+	
+	typedef boost::uint8_t stored_type;
+	static const size_t stored_bits = sizeof(stored_type) * 8;
+	
+	size_t pad_bits;
+	
+	std::vector<flag_type> values;
+	
+public:
+	
+	explicit stored_flag_map(size_t pad_bits = 32) : pad_bits(pad_bits) { }
+	
+	//! Declare the next possible flag.
+	void add(enum_type flag) {
+		values.push_back(flag);
+	}
+	
+	//! Load a flag set using the declared flags.
+	flag_type load(util::span_reader & is) const {
+		
+		size_t bytes = (values.size() + stored_bits - 1) / stored_bits;
+		
+		// 3-byte sets are padded to 4 bytes - consume the padding in the same call as the
+		// pointer is only valid until the next read for stream-backed readers
+		size_t padding = (bytes == 3 && pad_bits == 32) ? 1 : 0;
+		const char * data = is.take(bytes + padding);
+		
+		flag_type result = 0;
+		for(size_t i = 0; i < values.size(); i++) {
+			if(stored_type(data[i / stored_bits]) & (stored_type(1) << (i % stored_bits))) {
+				result |= values[i];
+			}
+		}
+		
+		return result;
+	}
+	
+};
+
 typedef stored_bitfield<256> stored_char_set;
 
 #endif // INNOEXTRACT_UTIL_STOREDENUM_HPP
@@ -22,11 +22,10 @@
 
 #include "configure.hpp"
 
-#if INNOEXTRACT_HAVE_TIMEGM || INNOEXTRACT_HAVE_GMTIME_R
-#include <time.h>
-#endif
-
 #include <stdlib.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -41,24 +40,16 @@
 #include <boost/filesystem/operations.hpp>
 #endif
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+
 #include "util/log.hpp"
 
 namespace util {
 
 #if defined(_WIN32)
 
-static const boost::int64_t FiletimeOffset = 0x19DB1DED53E8000ll;
-
-static time from_filetime(FILETIME ft) {
-	
-	boost::int64_t filetime = boost::int64_t(ft.dwHighDateTime) << 32;
-	filetime += boost::int64_t(ft.dwLowDateTime);
-	
-	filetime -= FiletimeOffset;
-	
-	return filetime / 10000000;
-}
-
 static FILETIME to_filetime(time t, boost::uint32_t nsec = 0) {
 	
 	static const boost::int64_t FiletimeOffset = 0x19DB1DED53E8000ll;
@@ -96,124 +87,222 @@ static void set_timezone(const char * value) {
 	
 }
 
-time parse_time(std::tm tm) {
-	
-	tm.tm_isdst = 0;
-	
-#if defined(_WIN32)
-	
-	// Windows
-	
-	SYSTEMTIME st;
-	st.wYear         = WORD(tm.tm_year + 1900);
-	st.wMonth        = WORD(tm.tm_mon + 1);
-	st.wDay          = WORD(tm.tm_mday);
-	st.wHour         = WORD(tm.tm_hour);
-	st.wMinute       = WORD(tm.tm_min);
-	st.wSecond       = WORD(tm.tm_sec);
-	st.wMilliseconds = 0;
+namespace {
+
+const boost::int64_t seconds_per_day = 24 * 60 * 60;
+
+//! Division rounding towards negative infinity.
+boost::int64_t floor_div(boost::int64_t a, boost::int64_t b) {
+	return (a >= 0) ? a / b : -((-a - 1) / b) - 1;
+}
+
+/*!
+ * Get the number of days since 1970-01-01 for a date in the proleptic Gregorian calendar.
+ *
+ * \param y Year
+ * \param m Month [1, 12]
+ * \param d Day of the month [1, 31]
+ */
+boost::int64_t days_from_civil(boost::int64_t y, unsigned m, unsigned d) {
 	
-	FILETIME ft;
-	if(!SystemTimeToFileTime(&st, &ft)) {
-		return 0;
-	}
-	return from_filetime(ft);
+	y -= (m <= 2);
 	
-#elif INNOEXTRACT_HAVE_TIMEGM
+	// 400-year cycles starting at 0000-03-01
+	boost::int64_t era = floor_div(y, 400);
+	unsigned year_of_era = unsigned(y - era * 400);                           // [0, 399]
+	unsigned day_of_year = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;   // [0, 365]
+	unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100
+	                      + day_of_year;                                      // [0, 146096]
 	
-	// GNU / BSD extension
+	return era * 146097 + boost::int64_t(day_of_era) - 719468;
+}
+
+//! Inverse of \ref days_from_civil.
+void civil_from_days(boost::int64_t days, boost::int64_t & y, unsigned & m, unsigned & d) {
+	
+	days += 719468;
+	
+	boost::int64_t era = floor_div(days, 146097);
+	unsigned day_of_era = unsigned(days - era * 146097);                      // [0, 146096]
+	unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524
+	                        - day_of_era / 146096) / 365;                     // [0, 399]
+	unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4
+	                                     - year_of_era / 100);                // [0, 365]
+	unsigned mp = (5 * day_of_year + 2) / 153;                                // [0, 11]
+	
+	d = day_of_year - (153 * mp + 2) / 5 + 1;
+	m = (mp < 10) ? mp + 3 : mp - 9;
+	y = boost::int64_t(year_of_era) + era * 400 + (m <= 2);
+}
+
+} // anonymous namespace
+
+time parse_time(std::tm tm) {
 	
-	return timegm(&tm);
+	// Normalize the month like timegm() and mktime() do
+	boost::int64_t year = boost::int64_t(tm.tm_year) + 1900 + floor_div(tm.tm_mon, 12);
+	unsigned month = unsigned(tm.tm_mon - floor_div(tm.tm_mon, 12) * 12) + 1;
 	
-#else
+	boost::int64_t days = days_from_civil(year, month, 1) + tm.tm_mday - 1;
 	
-	// Standard, but not thread-safe - should be OK for our use though
+	return days * seconds_per_day + boost::int64_t(tm.tm_hour) * 60 * 60
+	       + boost::int64_t(tm.tm_min) * 60 + tm.tm_sec;
+}
+
+std::tm format_time(time t) {
 	
-	char * tz = getenv("TZ");
+	std::tm ret = std::tm();
 	
-	set_timezone("UTC");
+	boost::int64_t days = floor_div(t, seconds_per_day);
+	int seconds = int(t - days * seconds_per_day);
 	
-	time ret = std::mktime(&tm);
+	boost::int64_t year;
+	unsigned month, day;
+	civil_from_days(days, year, month, day);
 	
-	set_timezone(tz);
+	ret.tm_year = int(year - 1900);
+	ret.tm_mon  = int(month) - 1;
+	ret.tm_mday = int(day);
+	ret.tm_hour = seconds / (60 * 60);
+	ret.tm_min  = seconds / 60 % 60;
+	ret.tm_sec  = seconds % 60;
+	ret.tm_wday = int(days - floor_div(days + 4, 7) * 7 + 4); // 1970-01-01 was a Thursday
+	ret.tm_yday = int(days - days_from_civil(year, 1, 1));
+	ret.tm_isdst = 0;
 	
 	return ret;
-	
-#endif
-	
 }
 
-template <typename Time>
-static Time to_time_t(time t, const char * file = "conversion") {
-	
-	Time ret = Time(t);
-	
-	if(time(ret) != t) {
-		log_warning << "Truncating timestamp " << t << " to " << ret << " for " << file;
-	}
-	
-	return ret;
-}
+namespace {
 
-std::tm format_time(time t) {
+//! 1970-01-02 - times before this may not be supported by mktime().
+const time table_begin = seconds_per_day;
+
+//! 2100-01-01
+const time table_end = 4102444800ll;
+
+/*!
+ * Interval between samples when building the table.
+ * Offsets in effect for less than this might be missed. This only happens for clock
+ * times skipped by the timezone, for which the result of mktime() is unreliable anyway.
+ */
+const time sample_step = 7 * seconds_per_day;
+
+/*!
+ * Offsets between UTC and local time for a range of times, so that converting timestamps
+ * does not need to go through the C library for every file.
+ *
+ * The table is built by sampling std::mktime() and then searching for the exact points
+ * where the offset changes, so it exactly reproduces the conversion done by the C library.
+ * Times outside of the table range fall back to calling std::mktime().
+ */
+class local_time_table {
 	
-	std::tm ret;
+	typedef std::pair<time, time> interval; //!< Start time and offset.
+	typedef std::vector<interval> interval_list;
 	
-#if defined(_WIN32)
+	interval_list intervals;
+	time end; //!< End of the range covered by \ref intervals.
 	
-	// Windows
+	boost::mutex mutex; //!< Serializes calls to std::mktime().
 	
-	FILETIME ft = to_filetime(t);
+	static bool starts_after(time t, const interval & i) { return t < i.first; }
 	
-	SYSTEMTIME st;
-	if(FileTimeToSystemTime(&ft, &st)) {
-		ret.tm_year = int(st.wYear) - 1900;
-		ret.tm_mon  = int(st.wMonth) - 1;
-		ret.tm_wday = int(st.wDayOfWeek);
-		ret.tm_mday = int(st.wDay);
-		ret.tm_hour = int(st.wHour);
-		ret.tm_min  = int(st.wMinute);
-		ret.tm_sec  = int(st.wSecond);
-	} else {
-		ret.tm_year = ret.tm_mon = ret.tm_mday = -1;
-		ret.tm_hour = ret.tm_min = ret.tm_sec = -1;
+	//! Interpret UTC clock time as local time.
+	static time convert_local(time t) {
+		std::tm tm = format_time(t);
+		tm.tm_isdst = 0;
+		return time(std::mktime(&tm));
 	}
-	ret.tm_isdst = -1;
-	
-#elif INNOEXTRACT_HAVE_GMTIME_R
-	
-	// POSIX.1
 	
-	time_t tt = to_time_t<time_t>(t);
-	gmtime_r(&tt, &ret);
+	static bool get_offset(time t, time & offset) {
+		time local = convert_local(t);
+		offset = local - t;
+		return (local != time(-1));
+	}
 	
-#else
+public:
 	
-	// Standard C++
+	local_time_table() : end(table_begin) { }
 	
-	std::time_t tt = to_time_t<std::time_t>(t);
-	std::tm * tmp = std::gmtime(&tt); /* not thread-safe */
-	if(tmp) {
-		ret = *tmp;
-	} else {
-		ret.tm_year = ret.tm_mon = ret.tm_mday = -1;
-		ret.tm_hour = ret.tm_min = ret.tm_sec = -1;
-		ret.tm_isdst = -1;
+	//! Build the table for the current timezone.
+	void build() {
+		
+		intervals.clear();
+		end = table_begin;
+		
+		time offset;
+		if(!get_offset(table_begin, offset)) {
+			return;
+		}
+		intervals.push_back(interval(table_begin, offset));
+		
+		time start = table_begin;
+		while(start < table_end) {
+			
+			time next = std::min(start + sample_step, table_end);
+			time next_offset;
+			if(!get_offset(next, next_offset)) {
+				break;
+			}
+			
+			while(next_offset != intervals.back().second) {
+				
+				// Binary search for the first time with a different offset
+				time low = start, high = next;
+				while(high - low > 1) {
+					time middle = low + (high - low) / 2;
+					if(!get_offset(middle, offset)) {
+						end = start;
+						return;
+					}
+					if(offset == intervals.back().second) {
+						low = middle;
+					} else {
+						high = middle;
+					}
+				}
+				
+				get_offset(high, offset);
+				intervals.push_back(interval(high, offset));
+				start = high;
+			}
+			
+			start = next;
+		}
+		
+		end = start;
 	}
 	
-#endif
+	time convert(time t) {
+		
+		if(t >= table_begin && t < end) {
+			interval_list::const_iterator i;
+			i = std::upper_bound(intervals.begin(), intervals.end(), t, starts_after);
+			return t + (i - 1)->second;
+		}
+		
+		boost::mutex::scoped_lock lock(mutex);
+		return convert_local(t);
+	}
 	
-	return ret;
+};
+
+boost::scoped_ptr<local_time_table> local_times;
+boost::once_flag local_times_once = BOOST_ONCE_INIT;
+
+void init_local_times() {
+	local_times.reset(new local_time_table);
+	local_times->build();
 }
 
+} // anonymous namespace
+
 time to_local_time(time t) {
 	
-	// Format time as UTC ...
-	std::tm time = format_time(t);
+	boost::call_once(local_times_once, init_local_times);
 	
-	// ... and interpret it as local time
-	time.tm_isdst = 0;
-	return std::mktime(&time);
+	return local_times->convert(t);
 }
 
 void set_local_timezone(std::string timezone) {
@@ -232,9 +321,28 @@ void set_local_timezone(std::string timezone) {
 	}
 	
 	set_timezone(timezone.c_str());
+	
+	// Cached offsets are for the old timezone
+	if(local_times) {
+		local_times->build();
+	}
 }
 
-#if defined(_WIN32)
+#if !defined(_WIN32)
+
+template <typename Time>
+static Time to_time_t(time t, const char * file = "conversion") {
+	
+	Time ret = Time(t);
+	
+	if(time(ret) != t) {
+		log_warning << "Truncating timestamp " << t << " to " << ret << " for " << file;
+	}
+	
+	return ret;
+}
+
+#else
 
 static HANDLE open_file(LPCSTR name) {
 	return CreateFileA(name, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
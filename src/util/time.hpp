@@ -39,28 +39,26 @@ typedef boost::int64_t time;
 /*!
  * Convert UTC clock time to a timestamp
  *
- * \note This function may not be thread-safe on all operating systems.
+ * Out-of-range fields are normalized.
  */
 time parse_time(std::tm tm);
 
-/*!
- * Convert a timestamp to UTC clock time
- *
- * \note This function may not be thread-safe on all operating systems.
- */
+//! Convert a timestamp to UTC clock time
 std::tm format_time(time t);
 
 /*!
  * Convert a timestamp to local time
  *
- * \note This function may not be thread-safe on all operating systems.
+ * The UTC offsets for the local timezone are determined on the first call and cached.
+ * Conversions for times between 1970 and 2100 don't need any locks.
  */
 time to_local_time(time t);
 
 /*!
  * Set the local timezone used by to_local_time
  *
- * \note This function is not thread-safe.
+ * \note This function is not thread-safe and must not be called while other threads
+ *       might use \ref to_local_time.
  */
 void set_local_timezone(std::string timezone);
 